@@ -0,0 +1,118 @@
+// A benchmark for the ListSegment growth policy.
+// Lists of elements of various sizes are built by prepending, one element at a time,
+//   and then iterated over repeatedly.
+// Build with different settings of LIST_SEGMENT_MAX_BYTES (and the other LIST_* sizes) to compare policies,
+//   (see cmds/bench-list-segments).
+
+// The runtime expects these definitions from the generated code.
+#include "runtime.h"
+struct ListStr { List elems; };
+const ReprList listStr = {{Repr_List, sizeof(List)}, &strRepr.base};
+struct MaybeChar { bool isYes; Char value; };
+const ReprMaybe maybeChar = {{Repr_Maybe, sizeof(MaybeChar)}, &charRepr.base, offsetof(MaybeChar, value)};
+struct ListChar { List elems; };
+const ReprList listChar = {{Repr_List, sizeof(List)}, &charRepr.base};
+struct ListInt { List elems; };
+const ReprList listInt = {{Repr_List, sizeof(List)}, &intRepr.base};
+typedef Any (*FunAnyAny_Func)(const void *, Any);
+struct FunAnyAny { FunAnyAny_Func func; const void *env; };
+Str STR_break = {true, false, false, 0, 5, "break"};
+Str STR_continue = {true, false, false, 0, 8, "continue"};
+Str STR_length = {true, false, false, 0, 6, "length"};
+Str STR_get = {true, false, false, 0, 3, "get"};
+Str STR_set = {true, false, false, 0, 3, "set"};
+Str STR_extend = {true, false, false, 0, 6, "extend"};
+Str STR_slice = {true, false, false, 0, 5, "slice"};
+Str STR_snapshot = {true, false, false, 0, 8, "snapshot"};
+Str STR_persistent = {true, false, false, 0, 10, "persistent"};
+Str STR_ephemeral = {true, false, false, 0, 9, "ephemeral"};
+Str STR_copy = {true, false, false, 0, 4, "copy"};
+Any any_primitive(Str name) { fatalError("any_primitive: not available in this benchmark"); }
+
+#include "runtime.c"
+
+#include <time.h>
+
+#define BENCH_MAX_INTS 50
+
+// a tuple of numInts ints
+ReprTuple bench_tupleRepr(int numInts) {
+    Field *fields = malloc(numInts * sizeof(Field));
+    for (int i = 0; i != numInts; i++) {
+        fields[i] = (Field){ "i", &intRepr.base, i * sizeof(int) };
+    }
+    Schema *schema = malloc(sizeof(Schema));
+    *schema = (Schema){ "bench", numInts * sizeof(int), numInts, fields, false, 0 };
+    return (ReprTuple){ { Repr_Tuple, numInts * sizeof(int), false, true }, schema };
+}
+
+double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void bench_run(const char *name, Repr elemRepr, int len, int numBuilds, int numIters) {
+    int elem[BENCH_MAX_INTS] = {};
+
+    // prepend-heavy
+    List lp = {};
+    double start = bench_now();
+    for (int b = 0; b != numBuilds; b++) {
+        lp = (List){};
+        for (int i = 0; i != len; i++) {
+            elem[0] = i;
+            lp = list_prepend1(elemRepr, lp, elem);
+        }
+    }
+    double prependNs = (bench_now() - start) * 1e9 / ((double) numBuilds * len);
+
+    // iterate-heavy
+    int numSegments = 0;
+    for (List it = lp; it.segment != NULL; it = it.segment->tail) {
+        numSegments += 1;
+    }
+    long sum = 0;
+    start = bench_now();
+    for (int r = 0; r != numIters; r++) {
+        List it = lp;
+        void *e = NULL;
+        while (list_iterate(elemRepr, &it, &e)) {
+            sum += *(int*) e;
+        }
+    }
+    double iterateNs = (bench_now() - start) * 1e9 / ((double) numIters * len);
+
+    printf("%-12s  elemSize %4zu  segments %6d  prepend %7.2f ns/elem  iterate %7.2f ns/elem  (%ld)\n",
+        name, elemRepr->size, numSegments, prependNs, iterateNs, sum);
+}
+
+int main(int argc, const char *argv[]) {
+    initPrimitives(argc, argv);
+    int len = argc > 1 ? atoi(argv[1]) : 1000000;
+    printf("LIST_SEGMENT_MAX_BYTES %d, length %d\n", LIST_SEGMENT_MAX_BYTES, len);
+
+    ReprTuple tuple16 = bench_tupleRepr(16);
+    ReprTuple tuple50 = bench_tupleRepr(50);
+    bench_run("Char", &charRepr.base, len, 10, 20);
+    bench_run("Int", &intRepr.base, len, 10, 20);
+    bench_run("Tuple 16Int", &tuple16.base, len, 4, 10);
+    bench_run("Tuple 50Int", &tuple50.base, len / 4, 4, 10);
+
+    // many short lists
+    double start = bench_now();
+    int numShort = len;
+    List keep = {};
+    for (int n = 0; n != numShort; n++) {
+        List lp = {};
+        for (int i = 0; i != 3; i++) {
+            lp = list_prepend1(&intRepr.base, lp, &i);
+        }
+        if (n % 1000 == 0) {
+            keep = lp;
+        }
+    }
+    printf("%-12s  length 3  prepend %7.2f ns/elem  (%d)\n", "short lists", (bench_now() - start) * 1e9 / (3.0 * numShort), list_length(keep));
+
+    return 0;
+}
@@ -1,9 +1,12 @@
 #include "runtime.h"
 #include "ordered-map.h"
 #include <gc.h>
+#include <gc_typed.h>
 
 
 #include <execinfo.h>
+#include <signal.h>
+#include <time.h>
 void printBacktrace(FILE * file) {
 
     void * frames[10];
@@ -68,6 +71,63 @@ void fatalError(const char * fmt, ...) {
 
 long mallocCounter = 0;
 
+// Allocation profiling.
+// Define RUNTIME_ALLOC_PROFILE as 1 to attribute the number and size of allocations 
+//   to the function which requested them, and to the Repr/Schema of the values allocated (when known).
+// The requesting function is the outermost caller of the malloc_*_or_panic functions, (see the macros in runtime.h),
+//   so the allocations made on behalf of any_pair are distinguished from those made on behalf of any_tail.
+// printDiagnostics dumps the table, sorted by bytes allocated, 
+//   or as JSON to the file named by the FERRUM_ALLOC_PROFILE environment variable.
+#if RUNTIME_ALLOC_PROFILE
+
+#define ALLOC_PROFILE_CAPACITY 4096
+
+typedef struct AllocProfileEntry {
+    const char *site;
+    Repr repr;
+    Schema *schema;
+    long count;
+    long bytes;
+} AllocProfileEntry;
+
+const char *allocSite = NULL;
+Repr allocRepr = NULL;
+Schema *allocSchema = NULL;
+AllocProfileEntry allocProfile[ALLOC_PROFILE_CAPACITY];
+int allocProfileSize = 0;
+long allocProfileOverflow = 0;
+
+void allocProfile_record(size_t size) {
+    const char *site = allocSite != NULL ? allocSite : "?";
+    Repr repr = allocRepr;
+    Schema *schema = allocSchema;
+    allocSite = NULL;
+    allocRepr = NULL;
+    allocSchema = NULL;
+    size_t i = (((uintptr_t) site * 31 + (uintptr_t) repr * 7 + (uintptr_t) schema) >> 3) % ALLOC_PROFILE_CAPACITY;
+    for (size_t n = 0; n != ALLOC_PROFILE_CAPACITY; n++, i = (i + 1) % ALLOC_PROFILE_CAPACITY) {
+        AllocProfileEntry *e = &allocProfile[i];
+        if (e->site == NULL) {
+            *e = (AllocProfileEntry){ site, repr, schema, 0, 0 };
+            allocProfileSize += 1;
+        }
+        if (e->site == site && e->repr == repr && e->schema == schema) {
+            e->count += 1;
+            e->bytes += size;
+            return;
+        }
+    }
+    allocProfileOverflow += 1;
+}
+#endif
+
+void countMalloc(size_t size) {
+    mallocCounter += 1;
+#if RUNTIME_ALLOC_PROFILE
+    allocProfile_record(size);
+#endif
+}
+
 void checkLargeMalloc(size_t size) {
     // if (size > 1024 * 1024) {
     //     fprintf(stderr, "Large Malloc %0.6f MB\n", ((float)size) / 1000 / 1000);
@@ -77,7 +137,9 @@ void checkLargeMalloc(size_t size) {
 }
 
 // perform all mallocs in one place, and check for failure
-void *malloc_or_panic(size_t size) {
+// (the names of the malloc_*_or_panic functions are parenthesized in their definitions, 
+//   so they are not expanded by the allocation profiling macros)
+void *(malloc_or_panic)(size_t size) {
     checkLargeMalloc(size);
     // void *ptr = malloc(size);
     void *ptr = GC_malloc(size);
@@ -89,22 +151,232 @@ void *malloc_or_panic(size_t size) {
     if (SAFETY_CHECK_ERROR(ptr == NULL)) {
         fatalError("malloc failed");
     }
-    mallocCounter += 1;
+    countMalloc(size);
     return ptr;
 }
 
-void *malloc_atomic_or_panic(size_t size) {
+// For large blocks which are only ever referenced by a pointer to their start, (such as the data in an Array).
+// The GC need not then avoid placing these blocks where they would be pinned by false pointers into their interior,
+//   which is what causes "GC Warning: Repeated allocation of very large block".
+void *(malloc_large_or_panic)(size_t size) {
+    checkLargeMalloc(size);
+    void *ptr = GC_malloc_ignore_off_page(size);
+    if (SAFETY_CHECK_ERROR(ptr == NULL)) {
+        fatalError("malloc failed");
+    }
+    countMalloc(size);
+    return ptr;
+}
+
+// For pointer-free payloads, (see malloc_repr_or_panic).
+// List element buffers are referenced through pointers into their interior (by any_head, any_listAt and list_span),
+//   and may be large (see LIST_SEGMENT_MAX_BYTES and LIST_CHUNK_BYTES),
+//   so this must not use the "_ignore_off_page" variant, (the GC would not otherwise keep the buffer alive).
+void *(malloc_atomic_or_panic)(size_t size) {
     checkLargeMalloc(size);
     // void *ptr = malloc(size);
     // void *ptr = GC_malloc(size);
-    // void *ptr = GC_malloc_atomic(size);
     // void *ptr = GC_malloc_ignore_off_page(size);
-    void *ptr = GC_malloc_atomic_ignore_off_page(size);
+    // void *ptr = GC_malloc_atomic_ignore_off_page(size);
+    void *ptr = GC_malloc_atomic(size);
     if (SAFETY_CHECK_ERROR(ptr == NULL)) {
         fatalError("malloc failed");
     }
-    mallocCounter += 1;
+    countMalloc(size);
+    return ptr;
+}
+
+// For string data.
+// Slices (see str_slice) point into the interior of their parent's data, and may be the only reference to it,
+//   so this must not use the "_ignore_off_page" variant, (the GC would not otherwise keep the data alive).
+void *(malloc_str_or_panic)(size_t size) {
+    checkLargeMalloc(size);
+    void *ptr = GC_malloc_atomic(size);
+    if (SAFETY_CHECK_ERROR(ptr == NULL)) {
+        fatalError("malloc failed");
+    }
+    countMalloc(size);
+    return ptr;
+}
+
+// Precise GC descriptors.
+// Values described by a Schema (tuples and closure environments), and List elements of such values,
+//   are allocated with a GC_descr bitmap, so the GC only traces the words which can hold pointers.
+// Define RUNTIME_TYPED_ALLOC as 0 to scan everything conservatively, for comparison.
+#ifndef RUNTIME_TYPED_ALLOC
+#define RUNTIME_TYPED_ALLOC 1
+#endif
+
+#define GC_WORD_INDEX(offset) ((offset) / sizeof(GC_word))
+
+// set the bitmap bits for the words within a value of the given Repr (at the given offset) which may hold pointers
+void gcDescr_setBits(GC_word * bitmap, Repr repr, size_t offset) {
+    if (repr->pointerFree) {
+        return;
+    }
+    switch (repr->tag) {
+        case Repr_Tuple: {
+            Schema * schema = ((ReprTuple*) repr)->schema;
+            for (int i = 0; i != schema->numFields; i++) {
+                Field field = schema->fields[i];
+                gcDescr_setBits(bitmap, field.repr, offset + field.offset);
+            }
+            break;
+        }
+        case Repr_Str:
+            GC_set_bit(bitmap, GC_WORD_INDEX(offset + offsetof(Str, data)));
+            break;
+        case Repr_List:
+            GC_set_bit(bitmap, GC_WORD_INDEX(offset + offsetof(List, segment)));
+            break;
+        default:
+            // conservatively treat every word the value overlaps as a potential pointer
+            for (size_t w = GC_WORD_INDEX(offset); w * sizeof(GC_word) < offset + repr->size; w++) {
+                GC_set_bit(bitmap, w);
+            }
+    }
+}
+
+GC_descr gcDescr_make(Repr repr, Schema * schema, size_t size) {
+    size_t numWords = (size + sizeof(GC_word) - 1) / sizeof(GC_word);
+    size_t bitmapSize = (numWords + GC_WORDSZ - 1) / GC_WORDSZ;
+    GC_word bitmap[bitmapSize + 1];
+    memset(bitmap, 0, sizeof(bitmap));
+    if (schema != NULL) {
+        for (int i = 0; i != schema->numFields; i++) {
+            Field field = schema->fields[i];
+            gcDescr_setBits(bitmap, field.repr, field.offset);
+        }
+    }
+    else {
+        gcDescr_setBits(bitmap, repr, 0);
+    }
+    return GC_make_descriptor(bitmap, numWords);
+}
+
+GC_descr schema_gcDescr(Schema * schema) {
+    if (!schema->gcDescrReady) {
+        schema->gcDescr = gcDescr_make(NULL, schema, schema->size);
+        schema->gcDescrReady = true;
+    }
+    return schema->gcDescr;
+}
+
+// the precise descriptor for a (non-pointer-free) Repr, if there is one
+bool repr_gcDescr(Repr repr, GC_descr * descr) {
+    static bool strDescrReady = false;
+    static GC_descr strDescr;
+    static bool listDescrReady = false;
+    static GC_descr listDescr;
+    switch (repr->tag) {
+        case Repr_Tuple:
+            *descr = schema_gcDescr(((ReprTuple*) repr)->schema);
+            return true;
+        case Repr_Str:
+            if (!strDescrReady) {
+                strDescr = gcDescr_make(repr, NULL, sizeof(Str));
+                strDescrReady = true;
+            }
+            *descr = strDescr;
+            return true;
+        case Repr_List:
+            if (!listDescrReady) {
+                listDescr = gcDescr_make(repr, NULL, sizeof(List));
+                listDescrReady = true;
+            }
+            *descr = listDescr;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// allocate space for payloads of the given Repr, 
+//   the GC won't scan the space for pointers if the Repr is known to be pointer-free,
+//   and will only scan the pointer-words if there's a precise descriptor for the Repr.
+// The size may be a multiple of the Repr size, (e.g. List segment element buffers).
+void *(malloc_repr_or_panic)(Repr repr, size_t size) {
+#if RUNTIME_ALLOC_PROFILE
+    allocRepr = allocRepr != NULL ? allocRepr : repr;
+#endif
+    if (repr->pointerFree) {
+        return malloc_atomic_or_panic(size);
+    }
+#if RUNTIME_TYPED_ALLOC
+    GC_descr descr;
+    if (repr->size != 0 && size % repr->size == 0 && repr_gcDescr(repr, &descr)) {
+        checkLargeMalloc(size);
+        size_t numElems = size / repr->size;
+        void *ptr = numElems == 1
+            ? GC_malloc_explicitly_typed(size, descr)
+            : GC_calloc_explicitly_typed(numElems, repr->size, descr);
+        if (SAFETY_CHECK_ERROR(ptr == NULL)) {
+            fatalError("malloc failed");
+        }
+        countMalloc(size);
+        return ptr;
+    }
+#endif
+    return malloc_or_panic(size);
+}
+
+void *(malloc_schema_or_panic)(Schema * schema, size_t size) {
+#if RUNTIME_ALLOC_PROFILE
+    allocSchema = allocSchema != NULL ? allocSchema : schema;
+#endif
+#if RUNTIME_TYPED_ALLOC
+    checkLargeMalloc(size);
+    void *ptr = GC_malloc_explicitly_typed(size, schema_gcDescr(schema));
+    if (SAFETY_CHECK_ERROR(ptr == NULL)) {
+        fatalError("malloc failed");
+    }
+    countMalloc(size);
+    return ptr;
+#else
+    return malloc_box_or_panic(size);
+#endif
+}
+
+// Size-class pool allocation of small fixed-size boxes.
+// Each size-class has its own free-list, refilled a page at a time with GC_malloc_many.
+// The free-list heads live in static memory, so unused pooled objects remain reachable, 
+//   and those handed out are collected like any other GC_malloc'd object.
+// Define RUNTIME_POOL_ALLOC as 0 to send every box straight to malloc_or_panic, for comparison.
+// (The runtime is single-threaded, the free-lists are not protected by any lock.)
+#ifndef RUNTIME_POOL_ALLOC
+#define RUNTIME_POOL_ALLOC 1
+#endif
+
+#define POOL_GRANULE 16
+#define POOL_NUM_CLASSES 8
+
+void * poolFreeLists[POOL_NUM_CLASSES];
+long poolRefillCounter = 0;
+
+// perform all fixed-size box allocations in one place
+void *(malloc_box_or_panic)(size_t size) {
+#if RUNTIME_POOL_ALLOC
+    size_t sizeClass = (size + POOL_GRANULE - 1) / POOL_GRANULE;
+    if (size == 0 || sizeClass > POOL_NUM_CLASSES) {
+        return malloc_or_panic(size);
+    }
+    void * * freeList = &poolFreeLists[sizeClass - 1];
+    if (*freeList == NULL) {
+        *freeList = GC_malloc_many(sizeClass * POOL_GRANULE);
+        if (SAFETY_CHECK_ERROR(*freeList == NULL)) {
+            fatalError("malloc failed");
+        }
+        poolRefillCounter += 1;
+    }
+    void *ptr = *freeList;
+    *freeList = GC_NEXT(ptr);
+    // GC_malloc_many clears everything except the link field
+    GC_NEXT(ptr) = NULL;
+    countMalloc(size);
     return ptr;
+#else
+    return malloc_or_panic(size);
+#endif
 }
 
 void *realloc_or_panic(void *ptr, size_t size) {
@@ -121,7 +393,7 @@ const void * mallocValue(Repr repr, const void * value) {
     if (repr->size == 0) {
         return NULL;
     }
-    void * ptr = malloc_or_panic(repr->size);
+    void * ptr = malloc_repr_or_panic(repr, repr->size);
     memcpy(ptr, value, repr->size);
     return ptr;
 }
@@ -161,6 +433,10 @@ void freePtr(const void *ptr) {
 
 #define VOID_PTR_ADD(ptr, num, size) ((void*)((char*)(ptr) + (num) * (size)))
 
+// A pointer to the payload of an Any, regardless of whether it is stored immediately or by reference.
+// The argument must be an lvalue, and the result is only valid for as long as that lvalue is.
+#define ANY_PAYLOAD(a) ((a).repr->immediate ? (const void*) &(a).value : (a).value)
+
 #define MEMCPY(toBase, toOffset, fromBase, fromOffset, numElems, elemSize) \
     memcpy(VOID_PTR_ADD(toBase, toOffset, elemSize), VOID_PTR_ADD(fromBase, fromOffset, elemSize), numElems * elemSize)
 
@@ -168,6 +444,15 @@ void freePtr(const void *ptr) {
 void printDiagnostics() {
     fflush(stdout);
     fprintf(stderr, "Malloc Counter: %ld\n", mallocCounter);
+#if RUNTIME_POOL_ALLOC
+    fprintf(stderr, "Pool Refills: %ld\n", poolRefillCounter);
+#endif
+#if RUNTIME_ALLOC_PROFILE
+    allocProfile_dump();
+#endif
+#if RUNTIME_GC_METRICS
+    gcMetrics_print("exit");
+#endif
     fflush(stderr);
 }
 
@@ -187,16 +472,25 @@ void printDiagnostics() {
 // ReprHdr anyRepr = { { Repr_Hdr } }; // a type that contains any value (as long as it starts with a Header)
 
 ReprAny anyRepr = { { Repr_Any, sizeof(Any) } };
-ReprNo noRepr = { { Repr_No, sizeof(No) } };
-ReprBool boolRepr = { { Repr_Bool, sizeof(bool) } };
-ReprInteger intRepr = { { Repr_Int, sizeof(int) }, true, sizeof(int) };
+ReprNo noRepr = { { Repr_No, sizeof(No), false, true } };
+ReprBool boolRepr = { { Repr_Bool, sizeof(bool), false, true } };
+ReprInteger intRepr = { { Repr_Int, sizeof(int), false, true }, true, sizeof(int) };
 ReprString strRepr = { { Repr_Str, sizeof(Str) } };
-ReprChar charRepr = { { Repr_Char, sizeof(Char) } };
-ReprType typeRepr = { { Repr_Type, sizeof(Type) } };
+ReprChar charRepr = { { Repr_Char, sizeof(Char), false, true } };
+ReprType typeRepr = { { Repr_Type, sizeof(Type), false, true } };
 ReprPair pairRepr = { { Repr_Pair, sizeof(Pair) } };
 ReprTupleTail tupleTailRepr = { { Repr_TupleTail, sizeof(TupleTail) } };
 ReprObject objectRepr = { { Repr_Object, sizeof(Object) } };
 
+// Immediate Reprs, the payload lives in the Any.value field itself, so boxing these datums never allocates.
+ReprBool boolImmRepr = { { Repr_Bool, sizeof(bool), true, true } };
+ReprInteger intImmRepr = { { Repr_Int, sizeof(int), true, true }, true, sizeof(int) };
+ReprChar charImmRepr = { { Repr_Char, sizeof(Char), true, true } };
+
+_Static_assert(sizeof(bool) <= sizeof(void*), "immediate Bool does not fit in Any.value");
+_Static_assert(sizeof(int)  <= sizeof(void*), "immediate Int does not fit in Any.value");
+_Static_assert(sizeof(Char) <= sizeof(void*), "immediate Char does not fit in Any.value");
+
 // Object objectMk(void *env, Any initState) {
 //     Any methods = *(Any*) env;
 //     MALLOC(Any, state, initState);
@@ -316,74 +610,286 @@ size_t min(size_t a, size_t b) {
 }
 
 
-// typedef struct {
-//     Ref ref;
-// } HashConsTableEntry;
+// Hash-consing.
+// any_hashCons returns a canonical instance of an immutable value (a Str, Pair or Tuple).
+// Every structurally equal value of the same Repr that is hash-consed, returns the same (repr, value) instance.
+// Pairs are hash-consed bottom-up, their heads and tails are hash-consed first, 
+//   so a pair is identified by the identities of its parts, and is hashed in O(1).
+// Strs and Tuples are hashed (with any_hash) and compared structurally, once, when they are first hash-consed,
+//   tuples holding functions or types cannot be compared, so are left unchanged.
+// Other values are returned unchanged.
+// Identical values are equal, so any_eq and any_compare can spot equal hash-consed values in O(1).
+// Distinct hash-consed values may still be equal, as the parts of a pair are not canonical (see any_eq).
+// Setting the FERRUM_HASH_CONS environment variable hash-conses every value boxed by any_from_str, any_pair and any_from_tuple.
+// Hash-consed values live for as long as the program does.
+
+typedef struct {
+    uint64_t hash;
+    Any value; // a NULL repr marks an empty entry
+} HashConsEntry;
+
+// open-addressing, with linear probing
+typedef struct {
+    HashConsEntry *entries;
+    size_t capacity; // zero, or a power of two
+    size_t size;
+} HashConsTable;
+
+// the canonical values, keyed by (structural) hash
+HashConsTable hashConsValues = {};
+// the same canonical values, keyed by the address of their payloads, for checking if a value is hash-consed
+HashConsTable hashConsPtrs = {};
+bool hashConsGlobal = false;
+
+uint64_t hashCons_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// The hash of a string's contents, cached in the string.
+// This is the string hash used by any_hash, hash-consing and interning.
+uint32_t str_hash(Str *str) {
+    if (str->hash == 0) {
+        Str flat = str_flat(*str);
+        // FNV-1a
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i != flat.len; i++) {
+            h = (h ^ (uint8_t) flat.data[i]) * 0x100000001b3ULL;
+        }
+        uint32_t h32 = hashCons_mix(h) >> 32;
+        // zero means not yet computed
+        str->hash = h32 != 0 ? h32 : 1;
+    }
+    return str->hash;
+}
+
+uint64_t hashCons_identityHash(Any a) {
+    return hashCons_mix((uintptr_t) a.repr ^ hashCons_mix((uintptr_t) a.value));
+}
+
+bool hashCons_identical(Any a, Any b) {
+    return a.repr == b.repr && a.value == b.value;
+}
 
-// typedef struct {
-//     unsigned idx;
-// } HashConsMapEntry;
+Any hashCons_lookup(HashConsTable *table, uint64_t hash, Any key, bool (*eq)(Any, Any)) {
+    if (table->capacity == 0) {
+        return (Any){};
+    }
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask; table->entries[i].value.repr != NULL; i = (i + 1) & mask) {
+        HashConsEntry *e = &table->entries[i];
+        if (e->hash == hash && eq(e->value, key)) {
+            return e->value;
+        }
+    }
+    return (Any){};
+}
 
-// HashConsTableEntry *hashConsTable;
+void hashCons_insert(HashConsTable *table, uint64_t hash, Any value) {
+    if (2 * (table->size + 1) > table->capacity) {
+        HashConsTable old = *table;
+        table->capacity = max(64, 2 * old.capacity);
+        table->entries = malloc_or_panic(table->capacity * sizeof(HashConsEntry));
+        memset(table->entries, 0, table->capacity * sizeof(HashConsEntry));
+        table->size = 0;
+        for (size_t i = 0; i != old.capacity; i++) {
+            if (old.entries[i].value.repr != NULL) {
+                hashCons_insert(table, old.entries[i].hash, old.entries[i].value);
+            }
+        }
+        freePtr(old.entries);
+    }
+    size_t mask = table->capacity - 1;
+    size_t i = hash & mask;
+    while (table->entries[i].value.repr != NULL) {
+        i = (i + 1) & mask;
+    }
+    table->entries[i] = (HashConsEntry){ hash, value };
+    table->size += 1;
+}
 
-// uint64_t hashConsNextIdx = 0;
-// // uint64_t hashConsTableSize = 0;
-// uint64_t hashConsTableCapacity = 0;
+bool hashCons_isInterned(Any a) {
+    return hashConsPtrs.size != 0
+        && hashCons_lookup(&hashConsPtrs, hashCons_identityHash(a), a, hashCons_identical).repr != NULL;
+}
 
-// OrderedMapPtr hashConsMap;
+Any hashCons_add(uint64_t hash, Any value) {
+    hashCons_insert(&hashConsValues, hash, value);
+    hashCons_insert(&hashConsPtrs, hashCons_identityHash(value), value);
+    return value;
+}
 
-// Ref hashConsRef(Ref a) {
-//     if (((uint64_t)a & 1) != 0) {
-//         return a;
-//     }
-//     uint64_t aBits = (uint64_t) omap_get(hashConsMap, a);
-//     if (aBits == 0) {
-//         uint64_t aIdx = hashConsNextIdx ++;
-//         if (aIdx >= hashConsTableCapacity) {
-//             hashConsTableCapacity = max(16, 2 * hashConsTableCapacity);
-//             hashConsTable = realloc_or_panic(hashConsTable, sizeof(HashConsTableEntry) * hashConsTableCapacity);
-//         }
-//         hashConsTable[aIdx].ref = a;
-//         aBits = (aIdx << 1) | 1;
-//         omap_set(hashConsMap, a, (Ref)aBits);
-//     }
-//     return (Ref) aBits;
-// }
+bool hashCons_strEq(Any a, Any b) {
+    return strEq(*(Str*) a.value, *(Str*) b.value);
+}
 
-// Ref getRef (Ref ref) {
-//     uint64_t refBits = (uint64_t) ref;
-//     if ((refBits & 1) != 0) {
-//         uint64_t idx = refBits >> 1;
-//         Ref refPtr = hashConsTable[idx].ref;
-//         return refPtr;
-//     }
-//     return ref;
-// }
+bool hashCons_pairEq(Any a, Any b) {
+    Pair *p = (Pair*) a.value;
+    Pair *q = (Pair*) b.value;
+    return hashCons_identical(p->hd, q->hd) && hashCons_identical(p->tl, q->tl);
+}
 
+bool hashCons_tupleEq(Any a, Any b) {
+    return a.repr == b.repr && any_eq(a, b);
+}
+
+// h and t must already be hash-consed
+Any hashCons_pair(Any h, Any t) {
+    Pair p = { h, t };
+    Any key = { &pairRepr.base, &p };
+    uint64_t hash = hashCons_mix(hashCons_identityHash(h) ^ hashCons_mix(hashCons_identityHash(t) + Repr_Pair));
+    Any found = hashCons_lookup(&hashConsValues, hash, key, hashCons_pairEq);
+    if (found.repr != NULL) {
+        return found;
+    }
+    return hashCons_add(hash, (Any){ &pairRepr.base, mallocValue(&pairRepr.base, &p) });
+}
+
+Any any_hashCons(Any a) {
+    a = any_to_any(a);
+    if (a.repr->immediate || any_isNil(a) || hashCons_isInterned(a)) {
+        return a;
+    }
+    switch (a.repr->tag) {
+        case Repr_Str: {
+            uint64_t hash = any_hash(a);
+            Any found = hashCons_lookup(&hashConsValues, hash, a, hashCons_strEq);
+            return found.repr != NULL ? found : hashCons_add(hash, a);
+        }
+        case Repr_Tuple: {
+            uint64_t hash = 0;
+            if (!any_tryHash(a, &hash)) {
+                // tuples holding functions or types cannot be compared, so are left as they are
+                return a;
+            }
+            Any found = hashCons_lookup(&hashConsValues, hash, a, hashCons_tupleEq);
+            return found.repr != NULL ? found : hashCons_add(hash, a);
+        }
+        case Repr_Pair: {
+            // collect the spine, so as to hash-cons it from the end, without recursing along the tail
+            size_t numHeads = 0;
+            size_t capacity = 16;
+            // from the GC heap, as the heads are only reachable from here while the pairs are rebuilt
+            Any *heads = malloc_or_panic(capacity * sizeof(Any));
+            Any it = a;
+            while (it.repr->tag == Repr_Pair && !hashCons_isInterned(it)) {
+                if (numHeads == capacity) {
+                    capacity *= 2;
+                    heads = realloc_or_panic(heads, capacity * sizeof(Any));
+                }
+                heads[numHeads++] = ((Pair*) it.value)->hd;
+                it = any_to_any(((Pair*) it.value)->tl);
+            }
+            Any t = any_hashCons(it);
+            for (size_t i = numHeads; i != 0; i--) {
+                t = hashCons_pair(any_hashCons(heads[i - 1]), t);
+            }
+            freePtr(heads);
+            return t;
+        }
+        default:
+            return a;
+    }
+}
+
+
+// A StringBuffer either accumulates a string in memory,
+//   or, when it has a file (sb_initFile), streams its contents to the file through a fixed-size buffer, 
+//   so large outputs (such as generated code) are never held in memory in full.
+// Output can be limited to maxLen bytes, after which "..." is written and everything else is dropped,
+//   and the show functions limit nesting to maxDepth, (zero for no limit).
+
+#ifndef SB_FILE_BUFFER_SIZE
+#define SB_FILE_BUFFER_SIZE (64*1024)
+#endif
 
 typedef struct {
     char *data;
     size_t capacity;
     size_t len;
+    FILE *file;
+    size_t flushed; // the number of bytes already written to the file
+    size_t maxLen;
+    int maxDepth;
+    int depth;
+    bool truncated;
 } StringBuffer;
 
 void sb_init(StringBuffer *sb) {
-    sb->data = NULL;
-    sb->capacity = 0;
-    sb->len = 0;
+    *sb = (StringBuffer){};
 }
 void sb_free(StringBuffer *sb) {
     freePtr(sb->data);
     sb_init(sb);
 }
 
+void sb_initFile(StringBuffer *sb, FILE *file) {
+    sb_init(sb);
+    sb->file = file;
+    sb->capacity = SB_FILE_BUFFER_SIZE;
+    sb->data = malloc(SB_FILE_BUFFER_SIZE);
+    if (SAFETY_CHECK_ERROR(sb->data == NULL)) {
+        fatalError("malloc failed");
+    }
+}
+
+void sb_flush(StringBuffer *sb) {
+    fwrite(sb->data, 1, sb->len, sb->file);
+    sb->flushed += sb->len;
+    sb->len = 0;
+}
+
+// flushes, and frees the buffer, the file is left open
+void sb_closeFile(StringBuffer *sb) {
+    sb_flush(sb);
+    free(sb->data);
+    sb_init(sb);
+}
+
+void sb_appendUnlimited(StringBuffer *sb, const char *in, size_t len);
+
 void sb_append(StringBuffer *sb, const char *in, size_t len) {
+    if (sb->maxLen != 0 && sb->flushed + sb->len + len > sb->maxLen) {
+        if (sb->truncated) {
+            return;
+        }
+        size_t room = sb->maxLen - min(sb->flushed + sb->len, sb->maxLen);
+        sb_appendUnlimited(sb, in, room);
+        sb_appendUnlimited(sb, "...", 3);
+        sb->truncated = true;
+        return;
+    }
+    sb_appendUnlimited(sb, in, len);
+}
+
+void sb_appendUnlimited(StringBuffer *sb, const char *in, size_t len) {
+    if (sb->file != NULL) {
+        if (len + 1 > sb->capacity - sb->len) {
+            sb_flush(sb);
+        }
+        if (len + 1 > sb->capacity) {
+            // too big to buffer, write it straight out
+            fwrite(in, 1, len, sb->file);
+            sb->flushed += len;
+            return;
+        }
+    }
     size_t required_space = len + 1;
     size_t remaining_space = sb->capacity - sb->len;
     if (required_space > remaining_space) {
         size_t required_capacity = sb->len + required_space;
         size_t new_capacity = max(required_capacity, max(2 * sb->capacity, 16));
-        sb->data = realloc_or_panic(sb->data, new_capacity);
+        if (sb->data == NULL) {
+            // the buffer only ever holds characters, start it off atomic, (realloc preserves the kind)
+            sb->data = malloc_str_or_panic(new_capacity);
+        }
+        else {
+            sb->data = realloc_or_panic(sb->data, new_capacity);
+        }
         sb->capacity = new_capacity;
     }
     memcpy(sb->data+sb->len, in, len);
@@ -393,13 +899,36 @@ void sb_append(StringBuffer *sb, const char *in, size_t len) {
     sb->data[sb->len] = '\0';
 }
 
+void sb_appendCStr(StringBuffer *sb, const char *in) {
+    sb_append(sb, in, strlen(in));
+}
+
+void sb_appendInt(StringBuffer *sb, int value) {
+    char buf[16];
+    char *p = buf + sizeof(buf);
+    unsigned int u = value < 0 ? -(unsigned int) value : value;
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    sb_append(sb, p, buf + sizeof(buf) - p);
+}
+
 void sb_printf(StringBuffer * sb, const char * fmt, ...) {
     va_list ap;
-    // TODO ? try to print directly into the StringBuffer in-place
-    // TODO ?   only call vsnprintf a second time if needed (once should be enough, most of the time)
+    // print directly into the StringBuffer in-place,
+    //   only call vsnprintf a second time if that doesn't fit
+    size_t remaining = sb->capacity - sb->len;
     va_start(ap, fmt);
-    int size = vsnprintf(NULL, 0, fmt, ap);
+    int size = vsnprintf(sb->data != NULL ? sb->data + sb->len : NULL, remaining, fmt, ap);
     va_end(ap);
+    if (size < remaining && (sb->maxLen == 0 || sb->flushed + sb->len + size <= sb->maxLen)) {
+        sb->len += size;
+        return;
+    }
     char buf[size+1];
     va_start(ap, fmt);
     vsnprintf(buf, size+1, fmt, ap);
@@ -407,55 +936,490 @@ void sb_printf(StringBuffer * sb, const char * fmt, ...) {
     sb_append(sb, buf, size);
 }
 
-// TODO ? provide a dynamic form of string interning / hashing?
-//   currently it is the callers responsibility to ensure this is only called once for each string value
-//   that is, hashing must be handled externally, typically in the code-generator
+// SIMD string scanning.
+// SSE2 is part of x86-64, AVX2 is used when the compiler targets it (-mavx2 / -march=native).
+// Anything else gets the scalar loops.
+
+#ifndef STR_SCAN_SIMD
+#ifdef __SSE2__
+#define STR_SCAN_SIMD 1
+#else
+#define STR_SCAN_SIMD 0
+#endif
+#endif
+
+#if STR_SCAN_SIMD
+#include <immintrin.h>
+#endif
+
+// UTF-8.
+// With STR_UTF8 (the default), positions in a string count characters, not bytes,
+//   (strLen, strCharAt, strCharAtMb, strSlice, strOrd, strChr and the byte-scanning primitives).
+// Every string records whether it contains any non-ASCII bytes (isMultibyte),
+//   this is found when the string is built, by a SIMD scan for bytes with the top bit set,
+//   (concatenations combine the flags of their parts, rather than scanning again).
+// Positions in an ASCII string are byte offsets, so the ASCII paths are unchanged.
+// Positions in a multibyte string are mapped to byte offsets by a sparse index (see StrUtf8Index).
+// Each byte of a malformed sequence counts as a character.
+// A Char holds a code point.
+// Define STR_UTF8 as 0 for byte positions throughout.
+
+#ifndef STR_UTF8
+#define STR_UTF8 1
+#endif
+
+// Whether a buffer contains any non-ASCII bytes, (always false without STR_UTF8).
+bool utf8_isMultibyte(const char *data, size_t len) {
+    if (!STR_UTF8) {
+        return false;
+    }
+    size_t i = 0;
+#if STR_SCAN_SIMD
+#ifdef __AVX2__
+    for (; i + 32 <= len; i += 32) {
+        if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*) (data + i))) != 0) {
+            return true;
+        }
+    }
+#endif
+    for (; i + 16 <= len; i += 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*) (data + i))) != 0) {
+            return true;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        if ((unsigned char) data[i] >= 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The length in bytes of the character starting at data[0], (len must be at least 1).
+// A malformed sequence (a stray continuation byte, an overlong form, a surrogate, or beyond U+10FFFF) has length 1.
+size_t utf8_charLen(const char *data, size_t len) {
+    const unsigned char *d = (const unsigned char*) data;
+    unsigned char b0 = d[0];
+    if (b0 < 0x80) {
+        return 1;
+    }
+    size_t n = b0 >= 0xF0 ? 4 : b0 >= 0xE0 ? 3 : b0 >= 0xC2 ? 2 : 1;
+    if (n == 1 || b0 > 0xF4 || n > len) {
+        return 1;
+    }
+    // the range of the second byte depends on the first
+    unsigned char lo = b0 == 0xE0 ? 0xA0 : b0 == 0xF0 ? 0x90 : 0x80;
+    unsigned char hi = b0 == 0xED ? 0x9F : b0 == 0xF4 ? 0x8F : 0xBF;
+    if (d[1] < lo || d[1] > hi) {
+        return 1;
+    }
+    for (size_t k = 2; k != n; k++) {
+        if ((d[k] & 0xC0) != 0x80) {
+            return 1;
+        }
+    }
+    return n;
+}
+
+// The code point of the character starting at data[0], (a malformed byte decodes as its own value).
+uint32_t utf8_decode(const char *data, size_t len) {
+    const unsigned char *d = (const unsigned char*) data;
+    switch (utf8_charLen(data, len)) {
+        case 2:
+            return ((d[0] & 0x1F) << 6) | (d[1] & 0x3F);
+        case 3:
+            return ((d[0] & 0x0F) << 12) | ((d[1] & 0x3F) << 6) | (d[2] & 0x3F);
+        case 4:
+            return ((d[0] & 0x07) << 18) | ((d[1] & 0x3F) << 12) | ((d[2] & 0x3F) << 6) | (d[3] & 0x3F);
+        default:
+            return d[0];
+    }
+}
+
+// Encodes a code point into buf (of at least 4 bytes), and returns the length.
+size_t utf8_encode(uint32_t cp, char *buf) {
+    if (cp < 0x80) {
+        buf[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        buf[0] = 0xC0 | (cp >> 6);
+        buf[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if (cp < 0x10000) {
+        buf[0] = 0xE0 | (cp >> 12);
+        buf[1] = 0x80 | ((cp >> 6) & 0x3F);
+        buf[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    buf[0] = 0xF0 | (cp >> 18);
+    buf[1] = 0x80 | ((cp >> 12) & 0x3F);
+    buf[2] = 0x80 | ((cp >> 6) & 0x3F);
+    buf[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+// The caller must ensure the result is the only static instance of its contents,
+//   either by interning it (str_internStatic), or by only calling this once for each string value.
+// Use str_intern to obtain the canonical instance of a string built at run-time.
 Str strStatic(const char *val, size_t len) {
     bool isStatic = true;
     // char *val2 = malloc_or_panic(len + 1);
     // memcpy(val2, val, len);
     // val2[len] = '\0';
-    Str s = { isStatic, len, val };
+    Str s = { isStatic, false, utf8_isMultibyte(val, len), 0, len, val };
     return s;
 }
 
+// Short strings.
+// Every string of (at most) one byte has a single static instance, so building one never allocates.
+// These are registered as interned by str_initSmall, before any other string is interned.
+char strSmallData[256][2];
+
+// len must be 0 or 1
+Str str_small(const char *val, size_t len) {
+    return len == 0 ? (Str){true, false, false, 0, 0, strSmallData[0] + 1} : (Str){true, false, false, 0, 1, strSmallData[(uint8_t) val[0]]};
+}
+
 Str strC(const char *val) {
     int len = strlen(val);
-    char *val2 = malloc_or_panic(len+1);
+    if (len <= 1) {
+        return str_small(val, len);
+    }
+    char *val2 = malloc_str_or_panic(len+1);
     memcpy(val2, val, len);
     val2[len] = '\0';
-    return (Str){false, len, val2};
+    return (Str){false, false, utf8_isMultibyte(val2, len), 0, len, val2};
 }
 
 Str str_new(const char *val, size_t len) {
-    char *val2 = malloc_or_panic(len+1);
+    if (len <= 1) {
+        return str_small(val, len);
+    }
+    char *val2 = malloc_str_or_panic(len+1);
     memcpy(val2, val, len);
     val2[len] = '\0';
-    return (Str){false, len, val2};
+    return (Str){false, false, utf8_isMultibyte(val2, len), 0, len, val2};
 }
 
+// A Char as a string, UTF-8 encoded, (without STR_UTF8 a Char is a single byte).
+Str char_to_str(Char ch) {
+    if (!STR_UTF8 || ch.value < 0x80) {
+        char byte = ch.value;
+        return str_small(&byte, 1);
+    }
+    char buf[4];
+    size_t len = utf8_encode(ch.value, buf);
+    return str_new(buf, len);
+}
 
-List list_prepend1 (Repr elemRepr, List lp, void * elem) {
-    if (lp.segment != NULL && elemRepr != lp.segment->elemRepr) {
-        fatalError("list_prepend1: incorrect elemRepr (%p) (%p)", elemRepr, lp.segment ? lp.segment->elemRepr : NULL);
+// If a string is exactly one character, that character.
+bool str_to_char(Str s, Char *ch) {
+    if (s.len == 1) {
+        *ch = (Char){ (unsigned char) s.data[0] };
+        return true;
     }
-    size_t elemSize = elemRepr->size;
-    if (lp.segment == NULL) {
-        int capacity = 1;
-        int numElems = 1;
-        int offset = capacity - 1;
-        void * elems = malloc_or_panic(capacity * elemSize);
-        MEMCPY(elems,offset,  elem,0,  1,elemSize);
-        MALLOC(ListSegment, segment, { capacity, numElems, elems, { NULL, 0 }, elemRepr });
-        return (List){ segment, offset };
+    // (a rope is never this short)
+    if (s.isMultibyte && s.len <= 4 && utf8_charLen(s.data, s.len) == s.len) {
+        *ch = (Char){ utf8_decode(s.data, s.len) };
+        return true;
     }
-    else {
-        int spaceExpected = lp.offset;
-        int spaceAvailable = lp.segment->capacity - lp.segment->numElems;
-        if (spaceAvailable > spaceExpected) {
-            fatalError("list_prepend1: impossible offset(%d)+ numElems(%d) > capacity(%d)", lp.offset, lp.segment->numElems, lp.segment->capacity);
-        }
-        if (spaceAvailable == spaceExpected && spaceAvailable > 0) {
+    return false;
+}
+
+
+// Ropes.
+// strAdd builds a rope, rather than copying its operands, once the result is long enough for the copying to matter,
+//   so building a string with a chain of n strAdds is O(n), not O(n^2).
+// A rope is flattened into a single buffer on the first access to its bytes (str_flat), 
+//   the buffer is cached in the rope, and the parts are released.
+// strLen, strEq, writeFile and sb_showStr walk the chunks of a rope (StrChunks), without flattening it.
+
+#ifndef STR_ROPE_MIN_LEN
+#define STR_ROPE_MIN_LEN 256
+#endif
+
+typedef struct {
+    Str left, right; // cleared once flattened
+    const char *flat;
+} StrRope;
+
+Str str_rope(Str left, Str right) {
+    MALLOC(StrRope, rope, { left, right, NULL });
+    return (Str){false, true, left.isMultibyte || right.isMultibyte, 0, left.len + right.len, (const char*) rope};
+}
+
+// Iterates over the contiguous chunks of a string, in order.
+// The pending parts are in the GC heap, as they may be the only references to them while the caller appends (and allocates).
+typedef struct {
+    Str *pending; // the parts still to visit, the next is at the end
+    size_t size;
+    size_t capacity;
+} StrChunks;
+
+void strChunks_push(StrChunks *it, Str s) {
+    if (it->size == it->capacity) {
+        it->capacity = max(16, 2 * it->capacity);
+        it->pending = it->pending == NULL
+            ? malloc_or_panic(it->capacity * sizeof(Str))
+            : realloc_or_panic(it->pending, it->capacity * sizeof(Str));
+    }
+    it->pending[it->size++] = s;
+}
+
+StrChunks strChunks_init(Str s) {
+    StrChunks it = { NULL, 0, 0 };
+    strChunks_push(&it, s);
+    return it;
+}
+
+void strChunks_free(StrChunks *it) {
+    freePtr(it->pending);
+    *it = (StrChunks){ NULL, 0, 0 };
+}
+
+bool strChunks_next(StrChunks *it, Str *chunk) {
+    while (it->size != 0) {
+        Str s = it->pending[--it->size];
+        if (s.isRope) {
+            StrRope *rope = (StrRope*) s.data;
+            if (rope->flat != NULL) {
+                *chunk = (Str){false, false, s.isMultibyte, 0, s.len, rope->flat};
+                return true;
+            }
+            strChunks_push(it, rope->right);
+            strChunks_push(it, rope->left);
+        }
+        else if (s.len != 0) {
+            *chunk = s;
+            return true;
+        }
+    }
+    strChunks_free(it);
+    return false;
+}
+
+Str str_flat(Str s) {
+    if (!s.isRope) {
+        return s;
+    }
+    StrRope *rope = (StrRope*) s.data;
+    if (rope->flat == NULL) {
+        char *flat = malloc_str_or_panic(s.len + 1);
+        size_t pos = 0;
+        StrChunks it = strChunks_init(s);
+        Str chunk;
+        while (strChunks_next(&it, &chunk)) {
+            memcpy(flat + pos, chunk.data, chunk.len);
+            pos += chunk.len;
+        }
+        flat[s.len] = '\0';
+        rope->flat = flat;
+        rope->left = (Str){};
+        rope->right = (Str){};
+    }
+    return (Str){false, false, s.isMultibyte, 0, s.len, rope->flat};
+}
+
+// Compares the contents of two strings of the same length, a chunk at a time.
+bool str_chunksEq(Str a, Str b) {
+    StrChunks itA = strChunks_init(a);
+    StrChunks itB = strChunks_init(b);
+    Str chunkA = {}, chunkB = {};
+    bool eq = true;
+    while (eq) {
+        if (chunkA.len == 0 && !strChunks_next(&itA, &chunkA)) {
+            break;
+        }
+        if (chunkB.len == 0 && !strChunks_next(&itB, &chunkB)) {
+            break;
+        }
+        size_t len = min(chunkA.len, chunkB.len);
+        eq = memcmp(chunkA.data, chunkB.data, len) == 0;
+        chunkA = (Str){false, false, chunkA.isMultibyte, 0, chunkA.len - len, chunkA.data + len};
+        chunkB = (Str){false, false, chunkB.isMultibyte, 0, chunkB.len - len, chunkB.data + len};
+    }
+    strChunks_free(&itA);
+    strChunks_free(&itB);
+    return eq;
+}
+
+
+// String interning.
+// An interned string is marked isStatic, and is the only static instance of its contents,
+//   so strEq compares two static strings by pointer.
+// The static strings emitted by the code-generator are registered (with str_internStatic) as the program starts,
+//   so a string built at run-time interns to the same instance as a literal with the same contents.
+// Interned strings live for as long as the program does.
+// The runtime is single-threaded, so, as with the allocation pools, the table isn't locked.
+
+typedef struct {
+    uint32_t hash;
+    Str str; // a NULL data marks an empty entry
+} StrInternEntry;
+
+// open-addressing, with linear probing
+typedef struct {
+    StrInternEntry *entries;
+    size_t capacity; // zero, or a power of two
+    size_t size;
+} StrInternTable;
+
+StrInternTable strInternTable = {};
+
+// returns the entry holding the contents of str, or the empty entry where it belongs
+StrInternEntry *strIntern_find(uint32_t hash, Str str) {
+    size_t mask = strInternTable.capacity - 1;
+    size_t i = hash & mask;
+    while (true) {
+        StrInternEntry *e = &strInternTable.entries[i];
+        if (e->str.data == NULL) {
+            return e;
+        }
+        if (e->hash == hash && e->str.len == str.len && memcmp(e->str.data, str.data, str.len) == 0) {
+            return e;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+void strIntern_reserve() {
+    if (2 * (strInternTable.size + 1) <= strInternTable.capacity) {
+        return;
+    }
+    StrInternTable old = strInternTable;
+    strInternTable.capacity = max(256, 2 * old.capacity);
+    strInternTable.entries = malloc_or_panic(strInternTable.capacity * sizeof(StrInternEntry));
+    memset(strInternTable.entries, 0, strInternTable.capacity * sizeof(StrInternEntry));
+    for (size_t i = 0; i != old.capacity; i++) {
+        if (old.entries[i].str.data != NULL) {
+            *strIntern_find(old.entries[i].hash, old.entries[i].str) = old.entries[i];
+        }
+    }
+    freePtr(old.entries);
+}
+
+Str str_intern(Str str) {
+    if (str.isStatic) {
+        return str;
+    }
+    str = str_flat(str);
+    strIntern_reserve();
+    uint32_t hash = str_hash(&str);
+    StrInternEntry *e = strIntern_find(hash, str);
+    if (e->str.data == NULL) {
+        // copy the contents, the original may be mutable, or later freed
+        char *data = malloc_str_or_panic(str.len + 1);
+        memcpy(data, str.data, str.len);
+        data[str.len] = '\0';
+        *e = (StrInternEntry){ hash, { true, false, str.isMultibyte, hash, str.len, data } };
+        strInternTable.size += 1;
+    }
+    return e->str;
+}
+
+// The interned instance of a string literal, interned on first use.
+#define STR_INTERN(lit) ({ \
+    static Str strInterned = {}; \
+    if (strInterned.data == NULL) { \
+        strInterned = str_intern((Str){ false, false, false, 0, sizeof(lit) - 1, lit }); \
+    } \
+    strInterned; \
+})
+
+// Registers a static string, or replaces it with the instance already interned with the same contents.
+void str_internStatic(Str *str) {
+    strIntern_reserve();
+    Str key = { true, false, str->isMultibyte, 0, str->len, str->data != NULL ? str->data : "" };
+    uint32_t hash = str_hash(&key);
+    StrInternEntry *e = strIntern_find(hash, key);
+    if (e->str.data == NULL) {
+        *e = (StrInternEntry){ hash, key };
+        strInternTable.size += 1;
+    }
+    *str = e->str;
+}
+
+void str_initSmall() {
+    Str empty = str_small(NULL, 0);
+    str_internStatic(&empty);
+    for (int i = 0; i != 256; i++) {
+        strSmallData[i][0] = i;
+        strSmallData[i][1] = '\0';
+        char ch = i;
+        Str s = str_small(&ch, 1);
+        str_internStatic(&s);
+    }
+}
+
+
+// Segment growth.
+// A segment is sized in bytes, rather than elements, so lists of small and of large elements get segments of a similar size.
+// A new segment doubles the occupancy of the segment it's prepended to, 
+//   from at least a cache line, up to LIST_SEGMENT_MAX_BYTES, (a few pages).
+// Segments of a page or more are whole pages, smaller segments are whole cache lines.
+// A list's first segment is only as big as it needs to be, (most lists are short),
+//   but capacities are always rounded up to fill the allocation granule,
+//   that space would otherwise be wasted, this way later prepends can fill it.
+
+#ifndef LIST_SEGMENT_MAX_BYTES
+#define LIST_SEGMENT_MAX_BYTES (16 * 1024)
+#endif
+#ifndef LIST_CACHE_LINE_BYTES
+#define LIST_CACHE_LINE_BYTES 64
+#endif
+#ifndef LIST_PAGE_BYTES
+#define LIST_PAGE_BYTES 4096
+#endif
+#define LIST_ALLOC_GRANULE_BYTES 16
+
+// The capacity for a segment needing room for at least minElems elements.
+int list_fitCapacity(Repr elemRepr, size_t minElems) {
+    size_t elemSize = max(1, elemRepr->size);
+    size_t bytes = (minElems * elemSize + LIST_ALLOC_GRANULE_BYTES - 1) / LIST_ALLOC_GRANULE_BYTES * LIST_ALLOC_GRANULE_BYTES;
+    return max(minElems, bytes / elemSize);
+}
+
+// The capacity for a new segment, following on from a segment with numElems elements, 
+//   and needing room for at least minElems.
+int list_growCapacity(Repr elemRepr, size_t numElems, size_t minElems) {
+    size_t elemSize = max(1, elemRepr->size);
+    size_t bytes = 2 * numElems * elemSize;
+    bytes = max(bytes, LIST_CACHE_LINE_BYTES);
+    bytes = min(bytes, LIST_SEGMENT_MAX_BYTES);
+    if (bytes >= LIST_PAGE_BYTES) {
+        bytes = bytes / LIST_PAGE_BYTES * LIST_PAGE_BYTES;
+    }
+    else {
+        bytes = (bytes + LIST_CACHE_LINE_BYTES - 1) / LIST_CACHE_LINE_BYTES * LIST_CACHE_LINE_BYTES;
+    }
+    return list_fitCapacity(elemRepr, max(minElems, bytes / elemSize));
+}
+
+List list_prepend1 (Repr elemRepr, List lp, void * elem) {
+    if (lp.segment != NULL && elemRepr != lp.segment->elemRepr) {
+        fatalError("list_prepend1: incorrect elemRepr (%p) (%p)", elemRepr, lp.segment ? lp.segment->elemRepr : NULL);
+    }
+    size_t elemSize = elemRepr->size;
+    if (lp.segment == NULL) {
+        int capacity = list_fitCapacity(elemRepr, 1);
+        int numElems = 1;
+        int offset = capacity - 1;
+        void * elems = malloc_repr_or_panic(elemRepr, capacity * elemSize);
+        memset(elems, '\0', offset * elemSize);
+        MEMCPY(elems,offset,  elem,0,  1,elemSize);
+        MALLOC(ListSegment, segment, { capacity, numElems, elems, { NULL, 0 }, 0, elemRepr });
+        return (List){ segment, offset };
+    }
+    else {
+        int spaceExpected = lp.offset;
+        int spaceAvailable = lp.segment->capacity - lp.segment->numElems;
+        if (spaceAvailable > spaceExpected) {
+            fatalError("list_prepend1: impossible offset(%d)+ numElems(%d) > capacity(%d)", lp.offset, lp.segment->numElems, lp.segment->capacity);
+        }
+        if (spaceAvailable == spaceExpected && spaceAvailable > 0) {
             int numElems = lp.segment->numElems;
             numElems += 1;
             int offset = lp.offset;
@@ -468,15 +1432,13 @@ List list_prepend1 (Repr elemRepr, List lp, void * elem) {
         else {
             // either there's no space left in this segment, 
             //   or the list has already been prepended to via another reference
-            // int capacity = 2 * lp.segment->capacity;
-            int capacity = 2 * lp.segment->numElems;
-            capacity = min(capacity, 1000);
+            int capacity = list_growCapacity(elemRepr, lp.segment->numElems, 1);
             int numElems = 1;
             int offset = capacity - 1;
-            void * elems = malloc_or_panic(capacity * elemSize);
+            void * elems = malloc_repr_or_panic(elemRepr, capacity * elemSize);
             MEMCPY(elems, offset, elem, 0, 1, elemSize);
             memset(elems, '\0', (capacity - numElems) * elemSize);
-            MALLOC(ListSegment, segment, { capacity, numElems, elems, lp, elemRepr });
+            MALLOC(ListSegment, segment, { capacity, numElems, elems, lp, list_length(lp), elemRepr });
             return (List){ segment, offset };
         }
     }
@@ -506,11 +1468,12 @@ List list_prependN (Repr elemRepr, List lp, int numElems, void * elems) {
     }
     size_t elemSize = elemRepr->size;
     if (lp.segment == NULL) {
-        int capacity = numElems;
-        void * elems2 = malloc_or_panic(capacity * elemSize);
-        MEMCPY(elems2, 0, elems, 0, numElems, elemSize);
-        MALLOC(ListSegment, segment, { capacity, numElems, elems2, { NULL, 0 }, elemRepr });
+        int capacity = list_fitCapacity(elemRepr, numElems);
         int offset = capacity - numElems;
+        void * elems2 = malloc_repr_or_panic(elemRepr, capacity * elemSize);
+        memset(elems2, '\0', offset * elemSize);
+        MEMCPY(elems2, offset, elems, 0, numElems, elemSize);
+        MALLOC(ListSegment, segment, { capacity, numElems, elems2, { NULL, 0 }, 0, elemRepr });
         return (List){ segment, offset };
     }
     else {
@@ -532,14 +1495,11 @@ List list_prependN (Repr elemRepr, List lp, int numElems, void * elems) {
             return lp;
         }
 
-        // int capacity = 2 * lp.segment->capacity;
-        int capacity = 2 * lp.segment->numElems;
-        capacity = min(capacity, 1000);
-        capacity = max(capacity, numElemsLeft);
-        void * elems2 = malloc_or_panic(capacity * elemSize);
+        int capacity = list_growCapacity(elemRepr, lp.segment->numElems, numElemsLeft);
+        void * elems2 = malloc_repr_or_panic(elemRepr, capacity * elemSize);
         MEMCPY(elems2, capacity - numElemsLeft, elems, 0, numElemsLeft, elemSize);
         memset(elems2, '\0', (capacity - numElemsLeft) * elemSize);
-        MALLOC(ListSegment, segment, { capacity, numElemsLeft, elems2, lp, elemRepr });
+        MALLOC(ListSegment, segment, { capacity, numElemsLeft, elems2, lp, list_length(lp), elemRepr });
         int offset = capacity - numElemsLeft;
         return (List){ segment, offset };
     }
@@ -582,21 +1542,84 @@ List list_tail(Repr elemRepr, List lp) {
         return (List) { lp.segment, lp.offset+1 };
     }
 }
+// Prepends in place, with the same rules as list_prepend1/list_prependN, 
+//   elements are only written into a segment's free space if no other list has already claimed it.
 void   list_frontPush(Repr elemRepr, List * lp, int numElems, void * elems) {
-    fatalError("TODO: list_frontPush");
+    if (numElems == 1) {
+        *lp = list_prepend1(elemRepr, *lp, elems);
+    }
+    else if (numElems != 0) {
+        *lp = list_prependN(elemRepr, *lp, numElems, elems);
+    }
 }
+// Returns the head, and steps the list on to its tail, in place.
+// The segments aren't modified, so this is safe on shared lists.
 void * list_frontPop (Repr elemRepr, List * lp) {
-    fatalError("TODO: list_frontPush");
+    if (lp->segment == NULL) {
+        fatalError("list_frontPop: expected a non-empty List");
+    }
+    if (elemRepr != lp->segment->elemRepr) {
+        fatalError("list_frontPop: incorrect elemRepr (%p) (%p)", elemRepr, lp->segment->elemRepr);
+    }
+    void * elem = VOID_PTR_ADD(lp->segment->elems, lp->offset, elemRepr->size);
+    lp->offset += 1;
+    if (lp->offset == lp->segment->capacity) {
+        *lp = lp->segment->tail;
+    }
+    return elem;
 }
 
 int list_length(List lp) {
-    int length = 0;
-    while (lp.segment != NULL) {
-        int occupancy = lp.segment->capacity - lp.offset;
-        length += occupancy;
+    if (lp.segment == NULL) {
+        return 0;
+    }
+    int occupancy = lp.segment->capacity - lp.offset;
+    return occupancy + lp.segment->tailLength;
+}
+
+// The element at the given position, whole segments are skipped over.
+void * list_at(Repr elemRepr, List lp, int pos) {
+    if (lp.segment != NULL && elemRepr != lp.segment->elemRepr) {
+        fatalError("list_at: incorrect elemRepr (%p) (%p)", elemRepr, lp.segment->elemRepr);
+    }
+    if (pos < 0 || pos >= list_length(lp)) {
+        fatalError("list_at: position (%d) out of range (%d)", pos, list_length(lp));
+    }
+    while (pos >= lp.segment->capacity - lp.offset) {
+        pos -= lp.segment->capacity - lp.offset;
         lp = lp.segment->tail;
     }
-    return length;
+    return VOID_PTR_ADD(lp.segment->elems, lp.offset + pos, elemRepr->size);
+}
+
+// Large lists are built as a chain of bounded segments, rather than in a single block,
+//   so as not to get "GC Warning: Repeated allocation of very large block" warnings from the Boehm GC,
+//   (nor need a contiguous multi-hundred-MB block for a long list).
+#define LIST_CHUNK_BYTES (64 * 1024)
+
+// the number of elements in a full chunk
+size_t list_chunkCapacity(Repr elemRepr) {
+    return max(1, LIST_CHUNK_BYTES / max(1, elemRepr->size));
+}
+
+// Allocate a list of the given length, ending in the given tail, as a chain of full segments of bounded size.
+// The head segment holds any remainder.
+// The elements are zeroed, the caller fills them in, front-to-back, by stepping through them with list_iterate.
+List list_alloc_chunked(Repr elemRepr, size_t len, List tail) {
+    size_t chunk = list_chunkCapacity(elemRepr);
+    size_t elemSize = elemRepr->size;
+    List lp = tail;
+    size_t remaining = len;
+    // the chain is built back-to-front, so each segment can point to the next
+    while (remaining != 0) {
+        int capacity = min(remaining, chunk);
+        void * elems = malloc_repr_or_panic(elemRepr, capacity * elemSize);
+        memset(elems, '\0', capacity * elemSize);
+        MALLOC(ListSegment, segment, { capacity, capacity, elems, lp, list_length(lp), elemRepr });
+        lp = (List){ segment, 0 };
+        remaining -= capacity;
+    }
+    return lp;
 }
 
 List list_reverse(Repr elemRepr, List lp) {
@@ -604,24 +1627,158 @@ List list_reverse(Repr elemRepr, List lp) {
     if (len == 0) {
         return (List){ NULL, 0 };
     }
-    void * data = malloc_or_panic(len * elemRepr->size);
-    int i = 0;
-    while (i != len) {
-        if (lp.segment == NULL) {
-            fatalError("impossible");
-        }
-        MEMCPY(data, len - 1 - i, lp.segment->elems, lp.offset, 1, elemRepr->size);
+    size_t chunk = list_chunkCapacity(elemRepr);
+    size_t elemSize = elemRepr->size;
+    // the result is built back-to-front, one bounded segment at a time, 
+    //   each segment is filled from its end, as if by prepending
+    List lp2 = { NULL, 0 };
+    int remaining = len;
+    while (lp.segment != NULL) {
+        if (lp2.offset == 0) {
+            int capacity = min(remaining, chunk);
+            void * elems = malloc_repr_or_panic(elemRepr, capacity * elemSize);
+            MALLOC(ListSegment, segment, { capacity, 0, elems, lp2, list_length(lp2), elemRepr });
+            lp2 = (List){ segment, capacity };
+        }
+        lp2.offset -= 1;
+        MEMCPY(lp2.segment->elems, lp2.offset, lp.segment->elems, lp.offset, 1, elemSize);
+        lp2.segment->numElems += 1;
+        remaining -= 1;
         lp.offset += 1;
         if (lp.offset == lp.segment->capacity) {
             lp = lp.segment->tail;
         }
-        i += 1;
     }
-    List lp2 = { NULL, 0 };
-    lp2 = list_prependN(elemRepr, lp2, len, data);
+    if (remaining != 0) {
+        fatalError("impossible");
+    }
     return lp2;
 }
 
+// Lists are built front-to-back, in a single pass, by appending to a ListBuilder.
+// Elements are appended to the end of the builder's last segment, 
+//   segments grow as prepended segments do, (see list_growCapacity).
+// The segments are private to the builder, until it is sealed, so they are appended to in place.
+// Sealing trims the last segment's capacity to its occupancy, so the result is an ordinary List.
+
+void listBuilder_init(ListBuilder * lb, Repr elemRepr) {
+    *lb = (ListBuilder){ elemRepr, { NULL, 0 }, NULL, 0 };
+}
+
+// The slot for the next element, zeroed, for the caller to fill in.
+void * listBuilder_alloc(ListBuilder * lb) {
+    ListSegment * last = lb->last;
+    size_t elemSize = lb->elemRepr->size;
+    if (last == NULL || last->numElems == last->capacity) {
+        size_t capacity = list_growCapacity(lb->elemRepr, last == NULL ? 0 : last->capacity, 1);
+        void * elems = malloc_repr_or_panic(lb->elemRepr, capacity * elemSize);
+        memset(elems, '\0', capacity * elemSize);
+        MALLOC(ListSegment, segment, { capacity, 0, elems, { NULL, 0 }, 0, lb->elemRepr });
+        if (last == NULL) {
+            lb->head = (List){ segment, 0 };
+        }
+        else {
+            last->tail = (List){ segment, 0 };
+        }
+        lb->last = last = segment;
+    }
+    void * slot = VOID_PTR_ADD(last->elems, last->numElems, elemSize);
+    last->numElems += 1;
+    lb->length += 1;
+    return slot;
+}
+
+void listBuilder_append(ListBuilder * lb, void * elem) {
+    void * slot = listBuilder_alloc(lb);
+    memcpy(slot, elem, lb->elemRepr->size);
+}
+
+// The built list, ending in the given tail.
+// The builder is left empty.
+List listBuilder_seal(ListBuilder * lb, List tail) {
+    if (lb->last == NULL) {
+        return tail;
+    }
+    if (tail.segment != NULL && lb->elemRepr != tail.segment->elemRepr) {
+        fatalError("listBuilder_seal: incorrect elemRepr (%p) (%p)", lb->elemRepr, tail.segment->elemRepr);
+    }
+    // the elements are at the front of the last segment's buffer, 
+    //   so its capacity is trimmed to match, and there's no space to prepend into
+    lb->last->capacity = lb->last->numElems;
+    lb->last->tail = tail;
+    // the segments' tail lengths are only known now
+    int tailLength = lb->length + list_length(tail);
+    for (ListSegment * segment = lb->head.segment; segment != tail.segment; segment = segment->tail.segment) {
+        tailLength -= segment->numElems;
+        segment->tailLength = tailLength;
+    }
+    List result = lb->head;
+    listBuilder_init(lb, lb->elemRepr);
+    return result;
+}
+
+// As ListBuilder, but for lists of pairs, (Any values).
+// The pairs are private to the builder until it is finished, so each is appended by setting the tail of the last in place.
+// With hash-consing, the pairs are only consed once they're finished, bottom-up.
+
+typedef struct {
+    Any head;
+    Pair *last;
+} AnyListBuilder;
+
+void anyListBuilder_init(AnyListBuilder * lb) {
+    *lb = (AnyListBuilder){ { &noRepr.base, NULL }, NULL };
+}
+
+void anyListBuilder_append(AnyListBuilder * lb, Any elem) {
+    Pair p = { elem, any_nil() };
+    Any pair = any_from_value(&pairRepr.base, &p);
+    if (lb->last == NULL) {
+        lb->head = pair;
+    }
+    else {
+        lb->last->tl = pair;
+    }
+    lb->last = (Pair*) pair.value;
+}
+
+// Re-conses the builder's private pairs, from the end, without recursing along the list.
+Any any_hashConsList(Any a, Any tail) {
+    size_t numPairs = 0;
+    size_t capacity = 16;
+    Pair ** pairs = malloc_or_panic(capacity * sizeof(Pair*));
+    for (Any it = a; any_isPair(it); it = ((Pair*) it.value)->tl) {
+        if (numPairs == capacity) {
+            capacity *= 2;
+            pairs = realloc_or_panic(pairs, capacity * sizeof(Pair*));
+        }
+        pairs[numPairs++] = (Pair*) it.value;
+    }
+    Any result = tail;
+    for (size_t i = numPairs; i != 0; i--) {
+        result = any_pair(pairs[i - 1]->hd, result);
+    }
+    freePtr(pairs);
+    return result;
+}
+
+// The built list, ending in the given tail.
+// The builder is left empty.
+Any anyListBuilder_finish(AnyListBuilder * lb, Any tail) {
+    Any result = tail;
+    if (lb->last != NULL) {
+        if (hashConsGlobal) {
+            result = any_hashConsList(lb->head, tail);
+        }
+        else {
+            lb->last->tl = tail;
+            result = lb->head;
+        }
+    }
+    anyListBuilder_init(lb);
+    return result;
+}
+
 bool list_iterate(Repr elemRepr, List * lp, void * * elem) {
     if (lp->segment != NULL && elemRepr != lp->segment->elemRepr) {
         fatalError("list_iterate: incorrect elemRepr (%p) (%p)", elemRepr, lp->segment ? lp->segment->elemRepr : NULL);
@@ -637,6 +1794,39 @@ bool list_iterate(Repr elemRepr, List * lp, void * * elem) {
     return true;
 }
 
+// Segment cursors.
+// A list's elements are contiguous within each segment, so a list can be walked a segment at a time, 
+//   with a tight loop over each segment's elements, (the generated stmt_forFoldLeft loops do this).
+// Returns the run of contiguous elements at the front of the list, and their number, (the count is zero at the end of the list).
+void * list_spanAt(Repr elemRepr, List lp, int * count) {
+    if (lp.segment == NULL) {
+        *count = 0;
+        return NULL;
+    }
+    if (elemRepr != lp.segment->elemRepr) {
+        fatalError("list_spanAt: incorrect elemRepr (%p) (%p)", elemRepr, lp.segment->elemRepr);
+    }
+    *count = lp.segment->capacity - lp.offset;
+    return VOID_PTR_ADD(lp.segment->elems, lp.offset, elemRepr->size);
+}
+
+// The rest of the list, after the run returned by list_spanAt.
+List list_spanRest(List lp) {
+    return lp.segment->tail;
+}
+
+// As list_spanAt, and steps the list on past the run.
+// The caller then holds only a pointer into the run's element buffer,
+//   which keeps the buffer alive (see malloc_atomic_or_panic), but not the rest of its segment.
+// Loops which allocate (as the generated stmt_forFoldLeft loops can) step on with list_spanRest once the run is consumed instead.
+void * list_span(Repr elemRepr, List * lp, int * count) {
+    void * elems = list_spanAt(elemRepr, *lp, count);
+    if (elems != NULL) {
+        *lp = list_spanRest(*lp);
+    }
+    return elems;
+}
+
 void * list_lookup(Repr keyValRepr, Repr valMbRepr, Str key, List lp) {
 
     if (keyValRepr->tag != Repr_Tuple) {
@@ -706,7 +1896,7 @@ void any_to_value(Any in, const Repr outRepr, void *outValue) {
 }
 
 const void * any_to_value_ptr(Any in, const Repr outRepr) {
-    void * result = malloc_or_panic(outRepr->size);
+    void * result = malloc_repr_or_panic(outRepr, outRepr->size);
     any_to_value(in, outRepr, result);
     return result;
 }
@@ -714,7 +1904,7 @@ const void * any_to_value_ptr(Any in, const Repr outRepr) {
 
 bool any_try_to_value(Any in, const Repr outRepr, void *outValue) {
     if (in.repr == outRepr) {
-        memcpy(outValue, in.value, in.repr->size);
+        memcpy(outValue, ANY_PAYLOAD(in), in.repr->size);
         return true;
     }
     if (in.repr->tag == Repr_Any) {
@@ -781,8 +1971,8 @@ bool any_try_to_value(Any in, const Repr outRepr, void *outValue) {
                 return true;
             }
             else if (in.repr->tag == Repr_Char) {
-                Char ch = *(Char*) in.value;
-                * (Str*) outValue = str_new(&ch.value, 1);
+                Char ch = *(Char*) ANY_PAYLOAD(in);
+                * (Str*) outValue = char_to_str(ch);
                 return true;
             }
             else {
@@ -791,18 +1981,12 @@ bool any_try_to_value(Any in, const Repr outRepr, void *outValue) {
         }
         case Repr_Char: {
             if (in.repr->tag == Repr_Char) {
-                * (Char*) outValue = *(Char*) in.value;
+                * (Char*) outValue = *(Char*) ANY_PAYLOAD(in);
                 return true;
             }
             if (in.repr->tag == Repr_Str) {
                 Str s = *(Str*) in.value;
-                if (s.len == 1) {
-                    * (Char*) outValue = (Char) { s.data[0] };
-                    return true;
-                }
-                else {
-                    return false;
-                }
+                return str_to_char(s, (Char*) outValue);
             }
             else {
                 return false;
@@ -850,27 +2034,24 @@ bool any_try_to_value(Any in, const Repr outRepr, void *outValue) {
             // TODO ? call any_to_list ?
             const ReprList *outReprList = (const ReprList*) outRepr;
             Repr elemRepr = outReprList->elem;
-            List outList = {NULL, 0};
-            void * elemValue = malloc_or_panic(elemRepr->size);
+            ListBuilder outList;
+            listBuilder_init(&outList, elemRepr);
             Any a = in;
             while (any_isPair(a)) {
                 Any elem = any_head(a);
                 Any next = any_tail(a);
                 // fprintf(stderr, "any_try_to_value: next(1): %s\n", showAny(next));
-                bool ok = any_try_to_value(elem, elemRepr, elemValue);
+                bool ok = any_try_to_value(elem, elemRepr, listBuilder_alloc(&outList));
                 // fprintf(stderr, "any_try_to_value: next(2): %s\n", showAny(next));
                 if (!ok) {
                     return false;
                 }
-                outList = list_prepend1(elemRepr, outList, elemValue);
-                // outList = list_prependN(elemRepr, outList, 1, elemValue);
                 a = next;
             }
             if (!any_isNil(a)) {
                 return false;
             }
-            outList = list_reverse(elemRepr, outList);
-            * (List*) outValue = outList;
+            * (List*) outValue = listBuilder_seal(&outList, (List){ NULL, 0 });
             return true;
         }
         case Repr_Tuple: {
@@ -989,12 +2170,22 @@ Any any_from_value(const Repr inRepr, const void * inValue) {
             Repr repr2 = unRepr->alts[tag];
             const void * value = VOID_PTR_ADD(inValue, unRepr->valueOffset, 1);
             // if the inValue was on the stack, make sure we copy it off
-            const void * value2 = mallocValue(repr2, value);
-            Any result = { repr2, value2 };
+            //   (or store it immediately, if the alternative has an immediate Repr)
+            Any result = any_from_value(repr2, value);
+            return result;
+        }
+        case Repr_No: {
+            Any result = { &noRepr.base, NULL };
             return result;
         }
+        case Repr_Bool:
+            return any_from_immediate(&boolImmRepr.base, inValue);
+        case Repr_Int:
+            return any_from_immediate(&intImmRepr.base, inValue);
+        case Repr_Char:
+            return any_from_immediate(&charImmRepr.base, inValue);
         default: {
-            void * value = malloc_or_panic(inRepr->size);
+            void * value = malloc_repr_or_panic(inRepr, inRepr->size);
             memcpy(value, inValue, inRepr->size);
             Any result = { inRepr, value };
             return result;
@@ -1003,15 +2194,27 @@ Any any_from_value(const Repr inRepr, const void * inValue) {
 }
 
 
+Any any_from_immediate(const Repr immRepr, const void * inValue) {
+    if (SAFETY_CHECK_ERROR(!immRepr->immediate)) {
+        fatalError("any_from_immediate: expected an immediate Repr (%d)", immRepr->tag);
+    }
+    Any result = { immRepr, NULL };
+    memcpy(&result.value, inValue, immRepr->size);
+    return result;
+}
+
+
 Any any_nil() {
-    No no = {};
-    Any result = any_from_value(&noRepr.base, &no);
+    Any result = { &noRepr.base, NULL };
     return result;
 }
 
 Any any_pair(Any h, Any t) {
     Pair p = { h, t };
     Any result = any_from_value(&pairRepr.base, &p);
+    if (hashConsGlobal) {
+        result = any_hashCons(result);
+    }
     return result;
 }
 
@@ -1021,40 +2224,31 @@ Any any_tuple2(Any a, Any b) {
 
 
 Any any_list_c(Any elem0, ...) {
-    Any elems = any_pair(elem0, any_nil());
+    AnyListBuilder elems;
+    anyListBuilder_init(&elems);
+    anyListBuilder_append(&elems, elem0);
     va_list ap;
     va_start(ap, elem0);
     Any elem = {};
     while ((elem = va_arg(ap, Any)).repr != NULL) {
-        elems = any_pair(elem, elems);
+        anyListBuilder_append(&elems, elem);
     }
     va_end(ap);
-    Any it = elems;
-    elems = any_nil();
-    elem = (Any){};
-    while (any_iterate(&it, &elem)) {
-        elems = any_pair(elem, elems);
-    }
-    return elems;
+    return anyListBuilder_finish(&elems, any_nil());
 }
 
 ListStr str_list_c(Str elem0, ...) {
-    List elems = {};
-    elems = list_prepend1(&strRepr.base, elems, &elem0);
+    ListBuilder elems;
+    listBuilder_init(&elems, &strRepr.base);
+    listBuilder_append(&elems, &elem0);
     va_list ap;
     va_start(ap, elem0);
     Str elem = {};
     while ((elem = va_arg(ap, Str)).data != NULL) {
-        elems = list_prepend1(&strRepr.base, elems, &elem);
+        listBuilder_append(&elems, &elem);
     }
     va_end(ap);
-    List it = elems;
-    elems = (List){};
-    Str * elemPtr = NULL;
-    while (list_iterate(&strRepr.base, &it, (void**)&elemPtr)) {
-        elems = list_prepend1(&strRepr.base, elems, elemPtr);
-    }
-    ListStr result = { elems };
+    ListStr result = { listBuilder_seal(&elems, (List){}) };
     return result;
 }
 
@@ -1093,22 +2287,89 @@ void copyOffStack(Repr repr, void *value) {
 
 
 
+#if RUNTIME_ALLOC_PROFILE
+int allocProfile_compare(const void *a, const void *b) {
+    long aBytes = ((const AllocProfileEntry *) a)->bytes;
+    long bBytes = ((const AllocProfileEntry *) b)->bytes;
+    return aBytes < bBytes ? 1 : aBytes > bBytes ? -1 : 0;
+}
+
+const char *allocProfile_label(const AllocProfileEntry *e) {
+    return e->schema != NULL ? e->schema->name : e->repr != NULL ? showRepr(e->repr) : "-";
+}
+
+void allocProfile_fprintJsonStr(FILE *file, const char *str) {
+    fputc('"', file);
+    for (const char *c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c == '\n' ? ' ' : *c, file);
+    }
+    fputc('"', file);
+}
+
+void allocProfile_dump() {
+    // showRepr allocates, so take a copy of the table before printing any of it
+    int numEntries = 0;
+    AllocProfileEntry *entries = malloc(allocProfileSize * sizeof(AllocProfileEntry) + 1);
+    for (int i = 0; i != ALLOC_PROFILE_CAPACITY; i++) {
+        if (allocProfile[i].site != NULL) {
+            entries[numEntries++] = allocProfile[i];
+        }
+    }
+    qsort(entries, numEntries, sizeof(AllocProfileEntry), allocProfile_compare);
+    const char *jsonFilename = getenv("FERRUM_ALLOC_PROFILE");
+    if (jsonFilename != NULL) {
+        FILE *file = fopen(jsonFilename, "w");
+        if (file == NULL) {
+            fatalError("allocProfile_dump: failed to open (%s)", jsonFilename);
+        }
+        fprintf(file, "[\n");
+        for (int i = 0; i != numEntries; i++) {
+            AllocProfileEntry *e = &entries[i];
+            fprintf(file, "  { \"site\": ");
+            allocProfile_fprintJsonStr(file, e->site);
+            fprintf(file, ", \"repr\": ");
+            allocProfile_fprintJsonStr(file, allocProfile_label(e));
+            fprintf(file, ", \"count\": %ld, \"bytes\": %ld }%s\n", e->count, e->bytes, i + 1 == numEntries ? "" : ",");
+        }
+        fprintf(file, "]\n");
+        fclose(file);
+    }
+    else {
+        fprintf(stderr, "Allocation Profile:\n");
+        fprintf(stderr, "  %12s %10s  %-32s %s\n", "Bytes", "Count", "Site", "Repr");
+        for (int i = 0; i != numEntries; i++) {
+            AllocProfileEntry *e = &entries[i];
+            fprintf(stderr, "  %12ld %10ld  %-32s %s\n", e->bytes, e->count, e->site, allocProfile_label(e));
+        }
+    }
+    if (allocProfileOverflow != 0) {
+        fprintf(stderr, "Allocation Profile Overflow: %ld\n", allocProfileOverflow);
+    }
+    free(entries);
+}
+#endif
+
 bool strEq(Str a, Str b) {
     if (a.isStatic && b.isStatic) {
         return a.len == b.len && a.data == b.data;
     }
+    else if (a.len != b.len || (a.hash != 0 && b.hash != 0 && a.hash != b.hash)) {
+        return false;
+    }
+    else if (a.isRope || b.isRope) {
+        return str_chunksEq(a, b);
+    }
     else {
         return (a.len == b.len && memcmp(a.data, b.data, a.len) == 0);
     }
 }
 
 bool str_char_eq(Str a, Char b) {
-    if (a.len == 1 && a.data[0] == b.value) {
-        return true;
-    }
-    else {
-        return false;
-    }
+    Char ch;
+    return str_to_char(a, &ch) && ch.value == b.value;
 }
 
 bool char_eq(Char a, Char b) {
@@ -1141,6 +2402,16 @@ Any any_to_any(Any a) {
             Any b = { ptrRepr->valueRepr, value };
             return any_to_any(b);
         }
+        case Repr_Bool:
+        case Repr_Int:
+        case Repr_Char: {
+            // scalars referred to by pointer (e.g. a List or Tuple element) are re-encoded immediately,
+            //   so the result doesn't keep the containing value reachable
+            if (a.repr->immediate) {
+                return a;
+            }
+            return any_from_value(a.repr, a.value);
+        }
         default:
             return a;
     }
@@ -1232,7 +2503,7 @@ Any any_tail(Any a) {
             List listValue = *(List*) a.value;
             Repr elemRepr = listRepr->elem;
             List tailValue = list_tail(elemRepr, listValue);
-            List *tailPtr = malloc_or_panic(sizeof(List));
+            List *tailPtr = malloc_box_or_panic(sizeof(List));
             *tailPtr = tailValue;
             // use a NULL header for now
             Any result = { &listRepr->base, tailPtr };
@@ -1481,7 +2752,7 @@ int any_to_int(Any a) {
     a = any_to_any(a);
     switch (a.repr->tag) {
         case Repr_Int: {
-            int result = *(int*)a.value;
+            int result = *(int*) ANY_PAYLOAD(a);
             return result;
         }
         case Repr_Any: {
@@ -1494,10 +2765,7 @@ int any_to_int(Any a) {
     }
 }
 Any any_from_int(int a) {
-    int *b = malloc_or_panic(sizeof(int));
-    *b = a;
-    Any result = { & intRepr.base, b };
-    return result;
+    return any_from_immediate(&intImmRepr.base, &a);
 }
 
 No any_to_nil(Any a) {
@@ -1515,7 +2783,7 @@ Any any_from_nil(No) {
 bool any_to_bool(Any a) {
     a = any_to_any(a);
     if (a.repr->tag == Repr_Bool) {
-        bool b = *(bool*) a.value;
+        bool b = *(bool*) ANY_PAYLOAD(a);
         return b;
     }
     else {
@@ -1523,10 +2791,7 @@ bool any_to_bool(Any a) {
     }
 }
 Any any_from_bool(bool a) {
-    bool *b = malloc_or_panic(sizeof(bool));
-    *b = a;
-    Any result = { & boolRepr.base, b };
-    return result;
+    return any_from_immediate(&boolImmRepr.base, &a);
 }
 
 Str any_to_str(Any a) {
@@ -1541,8 +2806,8 @@ Str any_to_str(Any a) {
         return b;
     }
     else if (a.repr->tag == Repr_Char) {
-        Char ch = *(Char*) a.value;
-        return str_new(&ch.value, 1);
+        Char ch = *(Char*) ANY_PAYLOAD(a);
+        return char_to_str(ch);
     }
     else if (a.repr->tag == Repr_Union) {
         Str b;
@@ -1554,9 +2819,12 @@ Str any_to_str(Any a) {
     }
 }
 Any any_from_str(Str a) {
-    Str *b = malloc_or_panic(sizeof(Str));
+    Str *b = malloc_box_or_panic(sizeof(Str));
     *b = a;
     Any result = { & strRepr.base, b };
+    if (hashConsGlobal) {
+        result = any_hashCons(result);
+    }
     return result;
 }
 
@@ -1583,7 +2851,7 @@ Type any_to_type(Any a) {
 
 }
 Any any_from_type(Type a) {
-    Type *b = malloc_or_panic(sizeof(Type));
+    Type *b = malloc_box_or_panic(sizeof(Type));
     *b = a;
     Any result = { & typeRepr.base, b };
     return result;
@@ -1609,9 +2877,12 @@ void * any_to_tuple(const ReprTuple *repr, Any a) {
 }
 
 Any any_from_tuple(const ReprTuple *tupleRepr, const void * a) {
-    void * a2 = malloc_or_panic(tupleRepr->base.size);
+    void * a2 = malloc_repr_or_panic(&tupleRepr->base, tupleRepr->base.size);
     memcpy(a2, a, tupleRepr->base.size);
     Any result = { & tupleRepr->base, a2 };
+    if (hashConsGlobal) {
+        result = any_hashCons(result);
+    }
     return result;
 }
 
@@ -1626,7 +2897,7 @@ Any any_from_maybe(const ReprMaybe *maybeRepr, const void * a) {
     if (isYes) {
         Repr valueRepr = maybeRepr->valueRepr;
         const void * valuePtr = VOID_PTR_ADD(a, maybeRepr->valueOffset, 1);
-        void * a2 = malloc_or_panic(valueRepr->size);
+        void * a2 = malloc_repr_or_panic(valueRepr, valueRepr->size);
         memcpy(a2, a, valueRepr->size);
         Any result = { valueRepr, a2 };
         return result;
@@ -1657,51 +2928,20 @@ List any_to_list(const Repr elemRepr, Any a) {
     }
     // else 
     {
-        size_t len = 0;
+        // the elements are converted directly into the list, in a single pass
+        ListBuilder lb;
+        listBuilder_init(&lb, elemRepr);
         Any it = a;
         Any elem;
         while (any_iterate(&it, &elem)) {
-            len += 1;
-        }
-        if (it.repr != NULL && it.repr->tag != Repr_List) {
-            fatalError("any_to_list: list-ptr tail must be nil, or another list-ptr, not (%d)\n", it.repr->tag);
-        }
-        if (len == 0) {
-            List listPtr = { NULL, 0 };
-            return listPtr;
-        }
-
-        // TODO allocate data in chunks, so as not to get
-        // TODO   "GC Warning: Repeated allocation of very large block"
-        // TODO warnings from the Boehm GC at runtime.
-        void *data = malloc_or_panic(elemSize * len);
-        it = a;
-        size_t i = 0;
-        // only copy up until a List is encountered, and use that in the tail segment
-        // while (it->tag != BOX_ListPtr && iterate(&it, &elem)) {
-        while (any_iterate(&it, &elem)) {
-        // while (it.repr->tag != Repr_List && any_iterate(&it, &elem)) {
-            any_to_value(elem, elemRepr, VOID_PTR_ADD(data, i, elemSize));
-            i += 1;
-        }
-        List tailPtr = { NULL, 0 };
-        if (it.repr == NULL) {
-            // nothing more to do
-        }
-        else if (it.repr->tag == Repr_List) {
-            // TODO we can no longer reach this branch, so delete this
-            tailPtr = *(List*) it.value;
-        }
-        else {
-            fatalError("impossible: any_to_list");
+            any_to_value(elem, elemRepr, listBuilder_alloc(&lb));
         }
-        List listPtr = list_prependN(elemRepr, tailPtr, len, data);
-        return listPtr;
+        return listBuilder_seal(&lb, (List){ NULL, 0 });
     }
 }
 
 Any any_from_list(const Repr listRepr, List a) {
-    List *b = malloc_or_panic(sizeof(List));
+    List *b = malloc_box_or_panic(sizeof(List));
     *b = a;
     Any result = { listRepr, b };
     return result;
@@ -1940,12 +3180,26 @@ bool lt (int a, int b) { return a <  b; }
 bool gte(int a, int b) { return a >= b; }
 bool lte(int a, int b) { return a <= b; }
 
+bool hashCons_kind(Any a) {
+    return a.repr->tag == Repr_Str || a.repr->tag == Repr_Pair || a.repr->tag == Repr_Tuple;
+}
+
 bool any_eq(Any a, Any b) {
     a = any_to_any(a);
     b = any_to_any(b);
+    // identical values are equal,
+    //   but distinct hash-consed values may still be equal, as the parts of a pair are not canonical,
+    //   (e.g. a List box and the pairs it unpacks to, or a Char and a one-character Str)
+    if (a.repr == b.repr && a.value == b.value && hashCons_kind(a)) {
+        return true;
+    }
     bool result;
     // fprintf(stderr, "eq "); printRef(stderr, a); fprintf(stderr, " == "); printRef(stderr, b); fprintf(stderr, "\n");
-    if (any_isNil(a) && any_isNil(b)) {
+    if (a.repr->immediate && b.repr->immediate && a.repr->tag == b.repr->tag) {
+        // same-tagged immediates can be compared without any unboxing
+        result = memcmp(&a.value, &b.value, a.repr->size) == 0;
+    }
+    else if (any_isNil(a) && any_isNil(b)) {
         result = true;
     }
     else if (any_isBool(a) && any_isBool(b)) {
@@ -1984,19 +3238,80 @@ bool any_eq(Any a, Any b) {
 }
 
 
-int int_sign (int num) {
-    if (num < 0) {
-        return -1;
-    }
-    else if (num > 0) {
-        return 1;
-    }
-    else {
-        return 0;
-    }
+// A structural hash, consistent with any_eq, equal values have equal hashes, whatever their Reprs.
+// So values are hashed by the same classification any_eq uses, (Char and Single values hash as strings, Tuples as pairs).
+// Str hashes are cached in the string, when the string is boxed in an Any.
+// Returns false, for values holding functions or types, as any_eq cannot compare them.
+bool any_tryHash(Any a, uint64_t *hash) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    while (true) {
+        a = any_to_any(a);
+        if (any_isNil(a)) {
+            *hash = hashCons_mix(h ^ 1);
+            return true;
+        }
+        else if (any_isBool(a)) {
+            *hash = hashCons_mix(h ^ (2 + any_to_bool(a)));
+            return true;
+        }
+        else if (any_isInt(a)) {
+            *hash = hashCons_mix(h ^ ((uint64_t) (uint32_t) any_to_int(a) << 8) ^ 4);
+            return true;
+        }
+        else if (any_isStr(a)) {
+            uint32_t strHash = 0;
+            if (a.repr->tag == Repr_Str) {
+                strHash = str_hash((Str*) a.value);
+            }
+            else {
+                Str s = any_to_str(a);
+                strHash = str_hash(&s);
+            }
+            *hash = hashCons_mix(h ^ ((uint64_t) strHash << 8) ^ 5);
+            return true;
+        }
+        else if (any_isPair(a)) {
+            // iterate, rather than recurse, along the tail
+            uint64_t headHash = 0;
+            if (!any_tryHash(any_head(a), &headHash)) {
+                return false;
+            }
+            h = hashCons_mix(h ^ headHash) + 6;
+            a = any_tail(a);
+        }
+        else {
+            return false;
+        }
+    }
+}
+
+uint64_t any_hash(Any a) {
+    uint64_t hash = 0;
+    if (!any_tryHash(a, &hash)) {
+        fatalError("any_hash: cannot hash functions or types");
+    }
+    return hash;
+}
+
+
+int int_sign (int num) {
+    if (num < 0) {
+        return -1;
+    }
+    else if (num > 0) {
+        return 1;
+    }
+    else {
+        return 0;
+    }
 }
 
 int str_compare(Str a, Str b) {
+    a = str_flat(a);
+    b = str_flat(b);
+    if (a.data == b.data && a.len == b.len) {
+        return 0;
+    }
     size_t minLen = min(a.len, b.len);
     int contentDiff = memcmp(a.data, b.data, minLen);
     if (contentDiff == 0) {
@@ -2011,6 +3326,16 @@ int str_compare(Str a, Str b) {
 int any_compare (Any a, Any b) {
     a = any_to_any(a);
     b = any_to_any(b);
+    if (a.repr == b.repr && a.value == b.value && hashCons_kind(a)) {
+        return 0;
+    }
+    if (a.repr->immediate && b.repr->immediate && a.repr->tag == b.repr->tag) {
+        switch (a.repr->tag) {
+            case Repr_Bool: return int_sign(*(bool*) ANY_PAYLOAD(a) - *(bool*) ANY_PAYLOAD(b));
+            case Repr_Int:  return int_sign(*(int*)  ANY_PAYLOAD(a) - *(int*)  ANY_PAYLOAD(b));
+            default: break;
+        }
+    }
     if (any_isNil(a) && any_isNil(b)) {
         return 0;
     }
@@ -2121,156 +3446,858 @@ void any_matchTuple2(Any a, Any * fst, Any * snd) {
 
 
 Any any_listAt (Any list, int pos0) {
+    list = any_to_any(list);
+    // positions within unboxed lists and tuples are found directly, without stepping through the elements
+    if (list.repr->tag == Repr_List) {
+        Repr elemRepr = ((ReprList*) list.repr)->elem;
+        List lp = *(List*) list.value;
+        if (pos0 >= 0 && pos0 < list_length(lp)) {
+            return (Any){ elemRepr, list_at(elemRepr, lp, pos0) };
+        }
+    }
+    else if (list.repr->tag == Repr_Tuple) {
+        Schema *schema = ((ReprTuple*) list.repr)->schema;
+        if (pos0 >= 0 && pos0 < schema->numFields) {
+            Field field = schema->fields[pos0];
+            return (Any){ field.repr, VOID_PTR_ADD(list.value, field.offset, 1) };
+        }
+    }
     int pos = pos0;
     Any elem = {};
     while (any_iterate(&list, &elem)) {
         if (pos == 0) {
             return elem;
         }
-        else {
-            pos --;
+        else {
+            pos --;
+        }
+    }
+    fatalError("any_listAt: expected a list of at least length (%d)", pos0);
+}
+
+// TODO
+// Ref reverseOnto(Ref a, Ref b) {
+// }
+
+
+// TODO use a (List Str) repr, not Any
+// TODO first need to give the codegen and runtime a common definition of a listStr repr.
+Str strCat (ListStr a) {
+    int len = 0;
+    bool isMultibyte = false;
+    List it = a.elems;
+    Str * elem = NULL;
+    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
+        len += elem->len;
+        isMultibyte |= elem->isMultibyte;
+    }
+    char *resultStr = malloc_str_or_panic(len+1);
+    int pos = 0;
+    it = a.elems;
+    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
+        Str s = str_flat(*elem);
+        memcpy (resultStr+pos, s.data, s.len);
+        pos += s.len;
+    }
+    resultStr[len] = '\0';
+    Str result = {false, false, isMultibyte, 0, len, resultStr};
+    return result;
+}
+
+
+Str strJoin (Str delim, ListStr list) {
+    int len = 0;
+    bool isMultibyte = false;
+    Str delimStr = delim;
+    List it = list.elems;
+    Str * elem = NULL;
+    bool first = true;
+    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
+        if (!first) {
+            len += delimStr.len;
+            isMultibyte |= delimStr.isMultibyte;
+        }
+        Str s = * elem;
+        len += s.len;
+        isMultibyte |= s.isMultibyte;
+        first = false;
+    }
+    char *resultStr = malloc_str_or_panic(len+1);
+    int pos = 0;
+    it = list.elems;
+    first = true;
+    delimStr = str_flat(delimStr);
+    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
+        if (!first) {
+            memcpy (resultStr+pos, delimStr.data, delimStr.len);
+            pos += delimStr.len;
+        }
+        Str s = str_flat(* elem);
+        memcpy (resultStr+pos, s.data, s.len);
+        pos += s.len;
+        first = false;
+    }
+    resultStr[len] = '\0';
+    Str result = {false, false, isMultibyte, 0, len, resultStr};
+    return result;
+}
+
+Str strAdd(Str a, Str b) {
+    if (b.len == 0) {
+        return a;
+    }
+    if (a.len == 0) {
+        return b;
+    }
+    size_t len = a.len + b.len;
+    if (len >= STR_ROPE_MIN_LEN) {
+        return str_rope(a, b);
+    }
+    a = str_flat(a);
+    b = str_flat(b);
+    char *resultStr = malloc_str_or_panic(len+1);
+    memcpy(resultStr, a.data, a.len);
+    memcpy(resultStr+a.len, b.data, b.len);
+    resultStr[len] = '\0';
+    Str result = {false, false, a.isMultibyte || b.isMultibyte, 0, len, resultStr};
+    return result;
+}
+
+// The sparse character index of a multibyte string.
+// offsets[k] is the byte offset of character (k * STR_UTF8_INDEX_STRIDE),
+//   so finding the offset of a character decodes fewer than STR_UTF8_INDEX_STRIDE characters,
+//   and moving forward from the previous position looked up (the cursor), as a scanner does, decodes fewer still.
+// Indexes are held in a small direct-mapped cache, keyed by the string's data pointer and length.
+// String buffers are never mutated once a Str refers to them, so equal keys mean equal contents,
+//   so long as a key's buffer cannot be freed and reused while it is cached.
+// It cannot, the cache is a GC root, and its data pointer keeps the whole buffer alive,
+//   even when it points into the interior of the buffer, as slices do (see malloc_str_or_panic).
+
+#ifndef STR_UTF8_INDEX_STRIDE
+#define STR_UTF8_INDEX_STRIDE 64
+#endif
+#ifndef STR_UTF8_INDEX_CACHE_SIZE
+#define STR_UTF8_INDEX_CACHE_SIZE 64
+#endif
+
+typedef struct {
+    Str str; // the (flat) string indexed, or a NULL data for an empty slot
+    size_t numChars;
+    size_t *offsets; // from the C heap, freed on eviction
+    size_t cursorPos;
+    size_t cursorOffset;
+} StrUtf8Index;
+
+StrUtf8Index strUtf8IndexCache[STR_UTF8_INDEX_CACHE_SIZE];
+
+// s must be flat
+StrUtf8Index *str_utf8Index(Str s) {
+    StrUtf8Index *idx = &strUtf8IndexCache[(((uintptr_t) s.data >> 4) ^ s.len) % STR_UTF8_INDEX_CACHE_SIZE];
+    if (idx->str.data == s.data && idx->str.len == s.len) {
+        return idx;
+    }
+    if (idx->str.data != NULL) {
+        free(idx->offsets);
+    }
+    // there are no more characters than bytes
+    size_t *offsets = malloc((s.len / STR_UTF8_INDEX_STRIDE + 1) * sizeof(size_t));
+    if (SAFETY_CHECK_ERROR(offsets == NULL)) {
+        fatalError("malloc failed");
+    }
+    size_t numChars = 0;
+    for (size_t i = 0; i < s.len; numChars++) {
+        if (numChars % STR_UTF8_INDEX_STRIDE == 0) {
+            offsets[numChars / STR_UTF8_INDEX_STRIDE] = i;
+        }
+        i += utf8_charLen(s.data + i, s.len - i);
+    }
+    *idx = (StrUtf8Index){ s, numChars, offsets, 0, 0 };
+    return idx;
+}
+
+// The byte offset of character pos, (s.len if pos is at or beyond the end).
+size_t str_posOffset(Str s, size_t pos) {
+    if (!s.isMultibyte) {
+        return min(pos, s.len);
+    }
+    StrUtf8Index *idx = str_utf8Index(s);
+    if (pos >= idx->numChars) {
+        return s.len;
+    }
+    size_t at = pos - pos % STR_UTF8_INDEX_STRIDE;
+    size_t offset = idx->offsets[pos / STR_UTF8_INDEX_STRIDE];
+    if (idx->cursorPos <= pos && idx->cursorPos > at) {
+        at = idx->cursorPos;
+        offset = idx->cursorOffset;
+    }
+    for (; at != pos; at++) {
+        offset += utf8_charLen(s.data + offset, s.len - offset);
+    }
+    idx->cursorPos = pos;
+    idx->cursorOffset = offset;
+    return offset;
+}
+
+// The position of the character starting at a byte offset.
+size_t str_offsetPos(Str s, size_t offset) {
+    if (!s.isMultibyte) {
+        return offset;
+    }
+    StrUtf8Index *idx = str_utf8Index(s);
+    if (offset >= s.len) {
+        return idx->numChars;
+    }
+    // the last index entry at or before the offset
+    size_t lo = 0;
+    size_t hi = (idx->numChars - 1) / STR_UTF8_INDEX_STRIDE;
+    while (lo != hi) {
+        size_t mid = (lo + hi + 1) / 2;
+        if (idx->offsets[mid] <= offset) {
+            lo = mid;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    size_t pos = lo * STR_UTF8_INDEX_STRIDE;
+    size_t at = idx->offsets[lo];
+    for (; at < offset; pos++) {
+        at += utf8_charLen(s.data + at, s.len - at);
+    }
+    return pos;
+}
+
+int strLen(Str a) {
+    return a.isMultibyte ? str_utf8Index(str_flat(a))->numChars : a.len;
+}
+
+int strOrd(Str a) {
+    Str s = str_flat(a);
+    if (s.len == 0) {
+        // temporary compatibility fudge, js runtime returns NaN in this case
+        return -1;
+    }
+    // if (s.len != 1) {
+    //     fatalError("strOrd: expected a string of length 1 (%d)", s.len);
+    // }
+    return s.isMultibyte ? utf8_decode(s.data, s.len) : (unsigned char) s.data[0];
+}
+
+Str strChr(int a) {
+    int i = a;
+#if STR_UTF8
+    if (SAFETY_CHECK_ERROR(!(0 <= i && i <= 0x10FFFF) || (0xD800 <= i && i <= 0xDFFF))) {
+        fatalError("strChr: expected a Unicode scalar value (%d)", i);
+    }
+#else
+    if (SAFETY_CHECK_ERROR(!(0 <= i && i <= 127))) {
+        // only support 7-bit ASCII strings for now
+        fatalError("strChr: expected a 7-bit char (%d)", i);
+    }
+#endif
+    return char_to_str((Char){ i });
+}
+
+Str strCharAt(Str a, int b) {
+    Str s = str_flat(a);
+    int i = b;
+    if (!(0 <= i && i < s.len)) {
+        // fatalError("strCharAt: position out of range (%d, %d)", i, s.len);
+        // this matches the current js runtime behaviour and is used to detect the end of a string
+        return str_small(NULL, 0);
+        // TODO ? use dependent-types to ensure the position is within range ?
+        // TODO ? re-enable the out-of-range fatal-error ?
+    }
+    if (s.isMultibyte) {
+        size_t offset = str_posOffset(s, i);
+        return offset == s.len ? str_small(NULL, 0) : str_slice(s, offset, offset + utf8_charLen(s.data + offset, s.len - offset));
+    }
+    return str_small(&s.data[i], 1);
+}
+
+// String slices.
+// A slice is a view, it shares the buffer of the string it is taken from, rather than copying the bytes.
+// So a view is not NUL-terminated, use str_cstr when a C string is needed.
+// A view keeps the whole of its parent alive, (string data is allocated with malloc_str_or_panic, so that interior pointers count),
+//   so a slice which is small relative to a large parent is compacted (copied) instead.
+
+#ifndef STR_SLICE_COMPACT_PARENT_LEN
+#define STR_SLICE_COMPACT_PARENT_LEN (1024*1024)
+#endif
+#ifndef STR_SLICE_COMPACT_RATIO
+#define STR_SLICE_COMPACT_RATIO 64
+#endif
+
+// start and end are byte offsets, clamped to the string, as in JS's String.slice (for non-negative positions).
+Str str_slice(Str s, size_t start, size_t end) {
+    s = str_flat(s);
+    end = min(end, s.len);
+    start = min(start, end);
+    size_t len = end - start;
+    if (len <= 1) {
+        return str_small(s.data + start, len);
+    }
+    if (len == s.len) {
+        return s;
+    }
+    if (s.len >= STR_SLICE_COMPACT_PARENT_LEN && len * STR_SLICE_COMPACT_RATIO < s.len) {
+        return str_new(s.data + start, len);
+    }
+    return (Str){false, false, s.isMultibyte && utf8_isMultibyte(s.data + start, len), 0, len, s.data + start};
+}
+
+// Every string built by the runtime is followed by a NUL, a view is followed by the rest of its parent.
+const char *str_cstr(Str s) {
+    s = str_flat(s);
+    return s.data[s.len] == '\0' ? s.data : str_new(s.data, s.len).data;
+}
+
+Str strSlice(Str a, int b, int c) {
+    Str s = str_flat(a);
+    return str_slice(s, str_posOffset(s, b < 0 ? 0 : b), str_posOffset(s, c < 0 ? 0 : c));
+}
+
+// Byte scanning.
+// These scan a whole buffer, a block of bytes at a time (see STR_SCAN_SIMD), rather than calling strCharAt once per character.
+
+// Sets with at most this many distinct bytes are matched with SIMD compares, one compare per member.
+// Larger sets are matched a byte at a time, by table lookup.
+#ifndef STR_SCAN_SIMD_MAX_SET
+#define STR_SCAN_SIMD_MAX_SET 8
+#endif
+
+#define STR_NOT_FOUND ((size_t) -1)
+
+typedef struct {
+    bool member[256];
+    size_t len; // the number of distinct members
+    unsigned char members[STR_SCAN_SIMD_MAX_SET];
+} ByteSet;
+
+void byteSet_init(ByteSet *set, Str chars) {
+    chars = str_flat(chars);
+    memset(set, 0, sizeof(ByteSet));
+    for (size_t i = 0; i != chars.len; i++) {
+        unsigned char ch = chars.data[i];
+        if (!set->member[ch]) {
+            set->member[ch] = true;
+            if (set->len < STR_SCAN_SIMD_MAX_SET) {
+                set->members[set->len] = ch;
+            }
+            set->len += 1;
+        }
+    }
+}
+
+// The position of the first byte, at or after pos, whose membership of the set is inSet, or s.len if there is none.
+size_t str_scanSet(Str s, size_t pos, const ByteSet *set, bool inSet) {
+    s = str_flat(s);
+    const unsigned char *data = (const unsigned char*) s.data;
+#if STR_SCAN_SIMD
+    if (set->len <= STR_SCAN_SIMD_MAX_SET) {
+#ifdef __AVX2__
+        __m256i members32[STR_SCAN_SIMD_MAX_SET];
+        for (size_t j = 0; j != set->len; j++) {
+            members32[j] = _mm256_set1_epi8(set->members[j]);
+        }
+        for (; pos + 32 <= s.len; pos += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i*) (data + pos));
+            __m256i match = _mm256_setzero_si256();
+            for (size_t j = 0; j != set->len; j++) {
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi8(block, members32[j]));
+            }
+            uint32_t mask = _mm256_movemask_epi8(match);
+            mask = inSet ? mask : ~mask;
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+#endif
+        __m128i members16[STR_SCAN_SIMD_MAX_SET];
+        for (size_t j = 0; j != set->len; j++) {
+            members16[j] = _mm_set1_epi8(set->members[j]);
+        }
+        for (; pos + 16 <= s.len; pos += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i*) (data + pos));
+            __m128i match = _mm_setzero_si128();
+            for (size_t j = 0; j != set->len; j++) {
+                match = _mm_or_si128(match, _mm_cmpeq_epi8(block, members16[j]));
+            }
+            uint32_t mask = _mm_movemask_epi8(match);
+            mask = inSet ? mask : ~mask & 0xFFFF;
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+    for (; pos < s.len; pos++) {
+        if (set->member[data[pos]] == inSet) {
+            return pos;
+        }
+    }
+    return s.len;
+}
+
+// The position of the first occurrence of needle, at or after pos, or STR_NOT_FOUND, as in JS's String.indexOf.
+// Candidates are found by comparing both the first and last bytes of the needle against a block of positions at once,
+//   only those are compared in full.
+size_t str_indexOf(Str s, size_t pos, Str needle) {
+    s = str_flat(s);
+    needle = str_flat(needle);
+    size_t m = needle.len;
+    pos = min(pos, s.len);
+    if (m == 0) {
+        return pos;
+    }
+    if (m > s.len - pos) {
+        return STR_NOT_FOUND;
+    }
+    const unsigned char *data = (const unsigned char*) s.data;
+#if STR_SCAN_SIMD
+#ifdef __AVX2__
+    __m256i first32 = _mm256_set1_epi8(needle.data[0]);
+    __m256i last32 = _mm256_set1_epi8(needle.data[m - 1]);
+    for (; pos + m - 1 + 32 <= s.len; pos += 32) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i*) (data + pos));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i*) (data + pos + m - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first32), _mm256_cmpeq_epi8(blockLast, last32)));
+        for (; mask != 0; mask &= mask - 1) {
+            size_t i = pos + __builtin_ctz(mask);
+            if (memcmp(data + i, needle.data, m) == 0) {
+                return i;
+            }
+        }
+    }
+#endif
+    __m128i first16 = _mm_set1_epi8(needle.data[0]);
+    __m128i last16 = _mm_set1_epi8(needle.data[m - 1]);
+    for (; pos + m - 1 + 16 <= s.len; pos += 16) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*) (data + pos));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*) (data + pos + m - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first16), _mm_cmpeq_epi8(blockLast, last16)));
+        for (; mask != 0; mask &= mask - 1) {
+            size_t i = pos + __builtin_ctz(mask);
+            if (memcmp(data + i, needle.data, m) == 0) {
+                return i;
+            }
+        }
+    }
+#endif
+    for (; pos + m <= s.len; pos++) {
+        if (data[pos] == (unsigned char) needle.data[0] && memcmp(data + pos, needle.data, m) == 0) {
+            return pos;
+        }
+    }
+    return STR_NOT_FOUND;
+}
+
+// As str_scanSet, for a set given as a multibyte string, a character at a time.
+// (An ASCII set can be scanned for a byte at a time, even in a multibyte string, 
+//   as no byte of a multibyte character is ASCII).
+size_t str_scanChars(Str s, size_t pos, Str chars, bool inSet) {
+    s = str_flat(s);
+    chars = str_flat(chars);
+    while (pos < s.len) {
+        size_t n = utf8_charLen(s.data + pos, s.len - pos);
+        bool member = false;
+        for (size_t i = 0; i < chars.len && !member; ) {
+            size_t m = utf8_charLen(chars.data + i, chars.len - i);
+            member = m == n && memcmp(chars.data + i, s.data + pos, n) == 0;
+            i += m;
+        }
+        if (member == inSet) {
+            return pos;
+        }
+        pos += n;
+    }
+    return s.len;
+}
+
+size_t str_scan(Str s, size_t pos, Str chars, bool inSet) {
+    if (chars.isMultibyte) {
+        return str_scanChars(s, pos, chars, inSet);
+    }
+    ByteSet set;
+    byteSet_init(&set, chars);
+    return str_scanSet(s, pos, &set, inSet);
+}
+
+// The end of the run of characters in chars, starting at pos.
+int strSpanWhile(Str a, int pos, Str chars) {
+    Str s = str_flat(a);
+    size_t i = str_scan(s, str_posOffset(s, pos < 0 ? 0 : pos), chars, false);
+    return str_offsetPos(s, i);
+}
+
+// The position of the first character in chars, at or after pos, or -1 if there is none.
+int strFindAny(Str a, int pos, Str chars) {
+    Str s = str_flat(a);
+    size_t i = str_scan(s, str_posOffset(s, pos < 0 ? 0 : pos), chars, true);
+    return i < s.len ? (int) str_offsetPos(s, i) : -1;
+}
+
+int strIndexOf(Str a, int pos, Str needle) {
+    Str s = str_flat(a);
+    size_t i = str_indexOf(s, str_posOffset(s, pos < 0 ? 0 : pos), needle);
+    return i != STR_NOT_FOUND ? (int) str_offsetPos(s, i) : -1;
+}
+
+// Splits a string on each occurrence of a delimiter, as in JS's String.split.
+// The parts are slices of the original string.
+ListStr strSplit(Str delim, Str a) {
+    delim = str_flat(delim);
+    a = str_flat(a);
+    size_t numParts = 0;
+    if (delim.len == 0) {
+        numParts = strLen(a);
+    }
+    else {
+        numParts = 1;
+        for (size_t i = str_indexOf(a, 0, delim); i != STR_NOT_FOUND; i = str_indexOf(a, i + delim.len, delim)) {
+            numParts += 1;
+        }
+    }
+    List result = list_alloc_chunked(&strRepr.base, numParts, (List){});
+    List slots = result;
+    Str *slot = NULL;
+    size_t start = 0;
+    for (size_t i = 0; list_iterate(&strRepr.base, &slots, (void**) &slot); ) {
+        if (delim.len == 0) {
+            size_t n = a.isMultibyte ? utf8_charLen(a.data + i, a.len - i) : 1;
+            *slot = str_slice(a, i, i + n);
+            i += n;
+        }
+        else {
+            i = str_indexOf(a, start, delim);
+            if (i == STR_NOT_FOUND) {
+                i = a.len;
+            }
+            *slot = str_slice(a, start, i);
+            start = i + delim.len;
+        }
+    }
+    return (ListStr){ result };
+}
+
+MaybeChar strCharAtMb(Str a, int b) {
+    Str s = str_flat(a);
+    int i = b;
+    if (!(0 <= i && i < s.len)) {
+        return (MaybeChar){false};
+    }
+    if (s.isMultibyte) {
+        size_t offset = str_posOffset(s, i);
+        if (offset == s.len) {
+            return (MaybeChar){false};
+        }
+        Char ch = { utf8_decode(s.data + offset, s.len - offset) };
+        return (MaybeChar){ true, ch };
+    }
+    Char ch = { (unsigned char) s.data[i] };
+    return (MaybeChar){ true, ch };
+}
+
+
+// List scanning.
+// Ints and Chars are both 32 bits wide, so the List Int and List Char primitives share these kernels.
+// Each kernel runs over one contiguous run of elements (see list_span), a block of elements at a time (see STR_SCAN_SIMD).
+
+int32_t i32_sum(const int32_t *a, int n) {
+    uint32_t sum = 0;
+    int i = 0;
+#if STR_SCAN_SIMD
+#ifdef __AVX2__
+    __m256i acc32 = _mm256_setzero_si256();
+    for (; i + 8 <= n; i += 8) {
+        acc32 = _mm256_add_epi32(acc32, _mm256_loadu_si256((const __m256i*) (a + i)));
+    }
+    __m128i acc = _mm_add_epi32(_mm256_castsi256_si128(acc32), _mm256_extracti128_si256(acc32, 1));
+#else
+    __m128i acc = _mm_setzero_si128();
+#endif
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_add_epi32(acc, _mm_loadu_si128((const __m128i*) (a + i)));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(acc);
+#endif
+    for (; i < n; i++) {
+        sum += (uint32_t) a[i];
+    }
+    return (int32_t) sum;
+}
+
+// The least (or greatest) of z and the elements.
+int32_t i32_minMax(bool isMax, int32_t z, const int32_t *a, int n) {
+    int i = 0;
+#if STR_SCAN_SIMD
+    if (n >= 4) {
+        int32_t lanes[4];
+#ifdef __AVX2__
+        __m256i acc32 = _mm256_set1_epi32(z);
+        for (; i + 8 <= n; i += 8) {
+            __m256i block = _mm256_loadu_si256((const __m256i*) (a + i));
+            acc32 = isMax ? _mm256_max_epi32(acc32, block) : _mm256_min_epi32(acc32, block);
+        }
+        __m128i lo = _mm256_castsi256_si128(acc32), hi = _mm256_extracti128_si256(acc32, 1);
+        __m128i acc = isMax ? _mm_max_epi32(lo, hi) : _mm_min_epi32(lo, hi);
+#else
+        __m128i acc = _mm_set1_epi32(z);
+#endif
+        for (; i + 4 <= n; i += 4) {
+            // SSE2 has no 32-bit min/max, so select with a compare.
+            __m128i block = _mm_loadu_si128((const __m128i*) (a + i));
+            __m128i take = isMax ? _mm_cmpgt_epi32(block, acc) : _mm_cmplt_epi32(block, acc);
+            acc = _mm_or_si128(_mm_and_si128(take, block), _mm_andnot_si128(take, acc));
+        }
+        _mm_storeu_si128((__m128i*) lanes, acc);
+        for (int j = 0; j != 4; j++) {
+            z = (isMax ? lanes[j] > z : lanes[j] < z) ? lanes[j] : z;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        z = (isMax ? a[i] > z : a[i] < z) ? a[i] : z;
+    }
+    return z;
+}
+
+// The position of the first element equal to x, or n if there is none.
+int i32_indexOf(const int32_t *a, int n, int32_t x) {
+    int i = 0;
+#if STR_SCAN_SIMD
+#ifdef __AVX2__
+    __m256i x32 = _mm256_set1_epi32(x);
+    for (; i + 8 <= n; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (a + i)), x32);
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    __m128i x16 = _mm_set1_epi32(x);
+    for (; i + 4 <= n; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i)), x16);
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
         }
     }
-    fatalError("any_listAt: expected a list of at least length (%d)", pos0);
+#endif
+    for (; i < n; i++) {
+        if (a[i] == x) {
+            return i;
+        }
+    }
+    return n;
 }
 
-// TODO
-// Ref reverseOnto(Ref a, Ref b) {
-// }
+// The position of the first element where a and b differ, or n if there is none.
+int i32_mismatch(const int32_t *a, const int32_t *b, int n) {
+    int i = 0;
+#if STR_SCAN_SIMD
+#ifdef __AVX2__
+    for (; i + 8 <= n; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (a + i)), _mm256_loadu_si256((const __m256i*) (b + i)));
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        if (mask != 0xFF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    for (; i + 4 <= n; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (mask != 0xF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (a[i] != b[i]) {
+            return i;
+        }
+    }
+    return n;
+}
 
+// Whether every element is an ASCII code point.
+bool u32_isAscii(const uint32_t *a, int n) {
+    uint32_t acc = 0;
+    int i = 0;
+#if STR_SCAN_SIMD
+    __m128i acc16 = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        acc16 = _mm_or_si128(acc16, _mm_loadu_si128((const __m128i*) (a + i)));
+    }
+    acc16 = _mm_or_si128(acc16, _mm_shuffle_epi32(acc16, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc16 = _mm_or_si128(acc16, _mm_shuffle_epi32(acc16, _MM_SHUFFLE(2, 3, 0, 1)));
+    acc = _mm_cvtsi128_si32(acc16);
+#endif
+    for (; i < n; i++) {
+        acc |= a[i];
+    }
+    return (acc & ~0x7Fu) == 0;
+}
 
-// TODO use a (List Str) repr, not Any
-// TODO first need to give the codegen and runtime a common definition of a listStr repr.
-Str strCat (ListStr a) {
-    int len = 0;
-    List it = a.elems;
-    Str * elem = NULL;
-    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
-        len += elem->len;
+// Stores the low byte of each element.
+void u32_narrow(const uint32_t *a, int n, char *out) {
+    int i = 0;
+#if STR_SCAN_SIMD
+    // Masking first keeps the saturating packs exact.
+    __m128i lowByte = _mm_set1_epi32(0xFF);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v0 = _mm_and_si128(_mm_loadu_si128((const __m128i*) (a + i)), lowByte);
+        __m128i v1 = _mm_and_si128(_mm_loadu_si128((const __m128i*) (a + i + 4)), lowByte);
+        __m128i v2 = _mm_and_si128(_mm_loadu_si128((const __m128i*) (a + i + 8)), lowByte);
+        __m128i v3 = _mm_and_si128(_mm_loadu_si128((const __m128i*) (a + i + 12)), lowByte);
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+        _mm_storeu_si128((__m128i*) (out + i), bytes);
     }
-    char *resultStr = malloc_atomic_or_panic(len+1);
-    int pos = 0;
-    it = a.elems;
-    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
-        memcpy (resultStr+pos, elem->data, elem->len);
-        pos += elem->len;
+#endif
+    for (; i < n; i++) {
+        out[i] = (char) a[i];
     }
-    resultStr[len] = '\0';
-    Str result = {false, len, resultStr};
-    return result;
 }
 
-
-Str strJoin (Str delim, ListStr list) {
-    int len = 0;
-    Str delimStr = delim;
-    List it = list.elems;
-    Str * elem = NULL;
-    bool first = true;
-    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
-        if (!first) {
-            len += delimStr.len;
+// Compares two lists of 32-bit elements, a run of elements at a time, returning -1, 0 or 1.
+// Ints compare as signed, Chars as unsigned (by code point).
+int list_compare32(Repr elemRepr, List a, List b, bool isSigned) {
+    const int32_t *ea = NULL, *eb = NULL;
+    int na = 0, nb = 0;
+    while (true) {
+        if (na == 0) {
+            ea = list_span(elemRepr, &a, &na);
         }
-        Str s = * elem;
-        len += s.len;
-        first = false;
+        if (nb == 0) {
+            eb = list_span(elemRepr, &b, &nb);
+        }
+        if (na == 0 || nb == 0) {
+            return (na != 0) - (nb != 0);
+        }
+        if (ea == eb && na == nb) {
+            // Both lists continue with the same segment, from the same offset.
+            return 0;
+        }
+        int n = na < nb ? na : nb;
+        int i = i32_mismatch(ea, eb, n);
+        if (i != n) {
+            if (isSigned) {
+                return ea[i] < eb[i] ? -1 : 1;
+            }
+            return (uint32_t) ea[i] < (uint32_t) eb[i] ? -1 : 1;
+        }
+        ea += n; na -= n;
+        eb += n; nb -= n;
     }
-    char *resultStr = malloc_atomic_or_panic(len+1);
+}
+
+int list_indexOf32(Repr elemRepr, List a, int32_t x) {
     int pos = 0;
-    it = list.elems;
-    first = true;
-    while (list_iterate(&strRepr.base, &it, (void**)&elem)) {
-        if (!first) {
-            memcpy (resultStr+pos, delimStr.data, delimStr.len);
-            pos += delimStr.len;
+    int count;
+    const int32_t *elems;
+    while ((elems = list_span(elemRepr, &a, &count)) != NULL) {
+        int i = i32_indexOf(elems, count, x);
+        if (i != count) {
+            return pos + i;
         }
-        Str s = * elem;
-        memcpy (resultStr+pos, s.data, s.len);
-        pos += s.len;
-        first = false;
+        pos += count;
     }
-    resultStr[len] = '\0';
-    Str result = {false, len, resultStr};
-    return result;
+    return -1;
 }
 
-Str strAdd(Str a, Str b) {
-    size_t len = a.len + b.len;
-    char *resultStr = malloc_atomic_or_panic(len+1);
-    memcpy(resultStr, a.data, a.len);
-    memcpy(resultStr+a.len, b.data, b.len);
-    resultStr[len] = '\0';
-    Str result = {false, len, resultStr};
-    return result;
+int intListSum(ListInt a) {
+    List list = a.elems;
+    uint32_t sum = 0;
+    int count;
+    const int32_t *elems;
+    while ((elems = list_span(&intRepr.base, &list, &count)) != NULL) {
+        sum += (uint32_t) i32_sum(elems, count);
+    }
+    return (int32_t) sum;
 }
 
-int strLen(Str a) {
-    return a.len;
+int intListMin(int z, ListInt a) {
+    List list = a.elems;
+    int count;
+    const int32_t *elems;
+    while ((elems = list_span(&intRepr.base, &list, &count)) != NULL) {
+        z = i32_minMax(false, z, elems, count);
+    }
+    return z;
 }
 
-int strOrd(Str a) {
-    Str s = a;
-    if (s.len == 0) {
-        // temporary compatibility fudge, js runtime returns NaN in this case
-        return -1;
+int intListMax(int z, ListInt a) {
+    List list = a.elems;
+    int count;
+    const int32_t *elems;
+    while ((elems = list_span(&intRepr.base, &list, &count)) != NULL) {
+        z = i32_minMax(true, z, elems, count);
     }
-    // if (s.len != 1) {
-    //     fatalError("strOrd: expected a string of length 1 (%d)", s.len);
-    // }
-    return s.data[0];
+    return z;
 }
 
-Str strChr(int a) {
-    int i = a;
-    if (SAFETY_CHECK_ERROR(!(0 <= i && i <= 127))) {
-        // only support 7-bit ASCII strings for now
-        fatalError("strChr: expected a 7-bit char (%d)", i);
-    }
-    char *result = malloc_or_panic(2);
-    result[0] = i;
-    result[1] = '\0';
-    return (Str){false, 1, result};
+int intListIndexOf(ListInt a, int x) {
+    return list_indexOf32(&intRepr.base, a.elems, x);
 }
 
-Str strCharAt(Str a, int b) {
-    Str s = a;
-    int i = b;
-    if (!(0 <= i && i < s.len)) {
-        // fatalError("strCharAt: position out of range (%d, %d)", i, s.len);
-        // this matches the current js runtime behaviour and is used to detect the end of a string
-        return (Str){false, 0, ""}; // TODO use a static reference to the empty string
-        // TODO ? use dependent-types to ensure the position is within range ?
-        // TODO ? re-enable the out-of-range fatal-error ?
-    }
-    char *result = malloc_or_panic(2);
-    result[0] = s.data[i];
-    result[1] = '\0';
-    return (Str){false, 1, result};
+bool intListEq(ListInt a, ListInt b) {
+    return list_length(a.elems) == list_length(b.elems) && list_compare32(&intRepr.base, a.elems, b.elems, true) == 0;
 }
 
-MaybeChar strCharAtMb(Str a, int b) {
-    Str s = a;
-    int i = b;
-    if (!(0 <= i && i < s.len)) {
-        return (MaybeChar){false};
-    }
-    Char ch = { s.data[i] };
-    return (MaybeChar){ true, ch };
+int intListCompare(ListInt a, ListInt b) {
+    return list_compare32(&intRepr.base, a.elems, b.elems, true);
+}
+
+int charListIndexOf(ListChar a, Char x) {
+    return list_indexOf32(&charRepr.base, a.elems, x.value);
+}
+
+bool charListEq(ListChar a, ListChar b) {
+    return list_length(a.elems) == list_length(b.elems) && list_compare32(&charRepr.base, a.elems, b.elems, false) == 0;
 }
 
+int charListCompare(ListChar a, ListChar b) {
+    return list_compare32(&charRepr.base, a.elems, b.elems, false);
+}
 
+// All-ASCII lists (and every list, without STR_UTF8) are narrowed a block at a time,
+//   others are encoded a character at a time.
 Str char_concat (ListChar a) {
+    char buf[4];
+    int length = 0;
+    bool isAscii = true;
     List list = a.elems;
-    int length = list_length(list);
-    char * chars = malloc_atomic_or_panic(length + 1);
-    char * ch = NULL;
+    int count;
+    const uint32_t *elems;
+    while ((elems = list_span(&charRepr.base, &list, &count)) != NULL) {
+        if (!STR_UTF8 || u32_isAscii(elems, count)) {
+            length += count;
+            continue;
+        }
+        isAscii = false;
+        for (int i = 0; i != count; i++) {
+            length += utf8_encode(elems[i], buf);
+        }
+    }
+    char * chars = malloc_str_or_panic(length + 1);
     int pos = 0;
-    while(list_iterate(&charRepr.base, &list, (void**)&ch)) {
-        chars[pos] = *ch;
-        pos += 1;
+    list = a.elems;
+    while ((elems = list_span(&charRepr.base, &list, &count)) != NULL) {
+        if (isAscii) {
+            u32_narrow(elems, count, chars + pos);
+            pos += count;
+            continue;
+        }
+        for (int i = 0; i != count; i++) {
+            pos += utf8_encode(elems[i], chars + pos);
+        }
     }
     chars[length] = '\0';
-    Str result = { false, length, chars };
+    Str result = { false, false, !isAscii, 0, length, chars };
     return result;
 }
 
@@ -2444,13 +4471,13 @@ Any any_trace(Any msg, Any val) {
     // TODO if the only thing being printed is a multi-line string, then
     // TODO print multi-line strings on mutiple lines
     // TODO   (currently they appear as a single string with embedded "\n" escapes)
-    fprintf(stderr, "C_RuntimeTrace: %s\n", showAny(msg));
+    fprintf(stderr, "C_RuntimeTrace: "); printAny(stderr, msg); fprintf(stderr, "\n");
     return val;
 }
 
 Any any_traceTwo(Any msg, Any k) {
     // TODO print multi-line strings on mutiple lines
-    fprintf(stderr, "C_RuntimeTrace: %s\n", showAny(msg));
+    fprintf(stderr, "C_RuntimeTrace: "); printAny(stderr, msg); fprintf(stderr, "\n");
     return any_call(k, any_nil());
 }
 
@@ -2472,57 +4499,80 @@ void sb_showSchemaData(StringBuffer * sb, Schema * schema, const void * data) {
     sb_printf(sb, ")");
 }
 
-void sb_showStr(StringBuffer *sb, Str in) {
+void sb_showStr(StringBuffer *sb, Str str) {
     sb_append(sb, "\"", 1);
-    for (int i=0; i != in.len; i++) {
-        char c = in.data[i];
-        if (c == '"') {
-            sb_append(sb, "\\\"", 2);
-        }
-        else if (c == '\\') {
-            sb_append(sb, "\\\\", 2);
-        }
-        else if (c >= 32 && c <= 126) {
-            sb_append(sb, &c, 1);
-        }
-        else if (c == '\t') {
-            sb_append(sb, "\\t", 2);
-        }
-        else if (c == '\n') {
-            sb_append(sb, "\\n", 2);
-        }
-        else if (c == '\r') {
-            sb_append(sb, "\\r", 2);
-        }
-        else {
-            // TODO use unicode syntax "\u{??????}" for chars > 255
-            // TODO or maybe arbitrary-width hex syntax "\x{??????}" for chars > 255
-            // TODO   the core-level language can handle wide-chars without a full understanding of unicode
-            // TODO   and sometimes wide non-unicode chars are needed
-            // TODO whether a string is unicode or not is perhaps best left 
-            // TODO   as a base-level language concept
-            char hexChars[] = "0123456789ABCDEF";
-            char hexEsc[] = "\\x??";
-            hexEsc[2] = hexChars[(c >> 4) & 0x0F];
-            hexEsc[3] = hexChars[ c       & 0x0F];
-            sb_append(sb, hexEsc, 4);
+    // a multibyte character could straddle the chunks of a rope
+    StrChunks chunks = strChunks_init(str.isMultibyte ? str_flat(str) : str);
+    Str in;
+    while (strChunks_next(&chunks, &in) && !sb->truncated) {
+        for (int i=0; i != in.len; i++) {
+            char c = in.data[i];
+            size_t n = in.isMultibyte ? utf8_charLen(in.data + i, in.len - i) : 1;
+            // a run of characters which need no escaping is appended in one go
+            size_t run = 0;
+            while (i + run != in.len && in.data[i + run] >= 32 && in.data[i + run] <= 126 && in.data[i + run] != '"' && in.data[i + run] != '\\') {
+                run += 1;
+            }
+            if (run != 0) {
+                sb_append(sb, in.data + i, run);
+                i += run - 1;
+            }
+            else if (n != 1) {
+                // well-formed UTF-8 is shown as it is
+                sb_append(sb, in.data + i, n);
+                i += n - 1;
+            }
+            else if (c == '"') {
+                sb_append(sb, "\\\"", 2);
+            }
+            else if (c == '\\') {
+                sb_append(sb, "\\\\", 2);
+            }
+            else if (c == '\t') {
+                sb_append(sb, "\\t", 2);
+            }
+            else if (c == '\n') {
+                sb_append(sb, "\\n", 2);
+            }
+            else if (c == '\r') {
+                sb_append(sb, "\\r", 2);
+            }
+            else {
+                // TODO use unicode syntax "\u{??????}" for chars > 255
+                // TODO or maybe arbitrary-width hex syntax "\x{??????}" for chars > 255
+                // TODO   the core-level language can handle wide-chars without a full understanding of unicode
+                // TODO   and sometimes wide non-unicode chars are needed
+                // TODO whether a string is unicode or not is perhaps best left 
+                // TODO   as a base-level language concept
+                char hexChars[] = "0123456789ABCDEF";
+                char hexEsc[] = "\\x??";
+                hexEsc[2] = hexChars[(c >> 4) & 0x0F];
+                hexEsc[3] = hexChars[ c       & 0x0F];
+                sb_append(sb, hexEsc, 4);
+            }
         }
     }
+    // truncation can end the loop before the chunks are exhausted
+    strChunks_free(&chunks);
     sb_append(sb, "\"", 1);
     return;
 }
 
 
 Any any_show(Any a) {
+    return any_showLimited(0, 0, a);
+}
+
+// As any_show, but limited to maxLen bytes and maxDepth levels of nesting, (zero for no limit), as printAnyLimited is.
+Any any_showLimited(int maxLen, int maxDepth, Any a) {
     StringBuffer sb;
     sb_init(&sb);
+    sb.maxLen = maxLen < 0 ? 0 : maxLen;
+    sb.maxDepth = maxDepth < 0 ? 0 : maxDepth;
     sb_showAny(&sb, a);
-    char * text = malloc_or_panic(sb.len + 1);
-    memcpy(text, sb.data, sb.len);
-    text[sb.len] = '\0';
-    Str resultStr = { false, sb.len, text };
+    // hand the buffer over to the result, rather than copying it
+    Str resultStr = { false, false, utf8_isMultibyte(sb.data, sb.len), 0, sb.len, sb.data };
     Any resultAny = any_from_str(resultStr);
-    sb_free(&sb);
     return resultAny;
 }
 
@@ -2721,7 +4771,7 @@ Any primMkArrayFastAccessNoCopy(Any repr, Any elems) {
         len += 1;
     }
     // allocate array
-    Any * data = malloc_or_panic(len * sizeof(Any));
+    Any * data = malloc_large_or_panic(len * sizeof(Any));
     it = elemsAny;
     size_t pos = 0;
     // copy vals into array
@@ -2848,6 +4898,106 @@ Any primMkArrayFastAccessSlowCopy(Any repr, Any elems) {
 
 
 
+// An ephemeral string-builder object, appends are amortized O(1).
+// Requests:
+//   ["append", str]          -> []
+//   ["appendMany", strList]  -> []
+//   ["length"]               -> Int, the length in characters, as strLen counts them
+//   ["finish"]               -> Str, the builder is then empty, and can be reused
+// As with ArrayFastAccessNoCopy, only the most recent instance of the object can be used.
+
+typedef struct {
+    StringBuffer sb;
+    size_t numChars;
+    int seqId;
+} StringBuilder;
+
+typedef StringBuilder *StringBuilderPtr;
+
+typedef struct {
+    Header hdr;
+    StringBuilderPtr builderR;
+    int seqIdR;
+} Env_StringBuilder;
+
+Header Env_StringBuilder_Header = 
+    { &(Schema){ "Env_StringBuilder", sizeof(Env_StringBuilder), 0, (Field[0]){
+    } } };
+
+// Returns the number of characters appended.
+size_t sb_appendStr(StringBuffer *sb, Str str) {
+    size_t numChars = 0;
+    StrChunks chunks = strChunks_init(str);
+    Str chunk;
+    while (strChunks_next(&chunks, &chunk)) {
+        sb_append(sb, chunk.data, chunk.len);
+        if (!chunk.isMultibyte) {
+            numChars += chunk.len;
+            continue;
+        }
+        for (size_t i = 0; i < chunk.len; numChars++) {
+            i += utf8_charLen(chunk.data + i, chunk.len - i);
+        }
+    }
+    return numChars;
+}
+
+Any StringBuilder_obj1(void *env, Any param);
+
+Any StringBuilder_obj(StringBuilderPtr builderR, int seqIdR, Any request) {
+    StringBuilderPtr builder = builderR;
+    int seqId = seqIdR;
+    if (SAFETY_CHECK_ERROR(seqId != builder->seqId)) {
+        fatalError("StringBuilder_obj: incorrect seqId (%d, %d)", seqId, builder->seqId);
+    }
+    builder->seqId += 1;
+    seqIdR = builder->seqId;
+    MALLOC(Env_StringBuilder, newEnv, { Env_StringBuilder_Header, builderR, seqIdR });
+    Any builderObj = adaptClosure_Any_to_Any(StringBuilder_obj1, newEnv);
+    Str req = any_to_str(any_head(request));
+    if (strEq(req, STR_INTERN("append"))) {
+        builder->numChars += sb_appendStr(&builder->sb, any_to_str(any_listAt(request, 1)));
+        return any_tuple2(builderObj, any_nil());
+    }
+    else if (strEq(req, STR_INTERN("appendMany"))) {
+        Any it = any_listAt(request, 1);
+        Any elem = {};
+        while (any_iterate(&it, &elem)) {
+            builder->numChars += sb_appendStr(&builder->sb, any_to_str(elem));
+        }
+        return any_tuple2(builderObj, any_nil());
+    }
+    else if (strEq(req, STR_length)) {
+        return any_tuple2(builderObj, any_from_int(builder->numChars));
+    }
+    else if (strEq(req, STR_INTERN("finish"))) {
+        // hand the buffer over to the result, rather than copying it
+        Str result = builder->sb.len <= 1 
+            ? str_small(builder->sb.data, builder->sb.len) 
+            : (Str){false, false, utf8_isMultibyte(builder->sb.data, builder->sb.len), 0, builder->sb.len, builder->sb.data};
+        sb_init(&builder->sb);
+        builder->numChars = 0;
+        return any_tuple2(builderObj, any_from_str(result));
+    }
+    fatalError("StringBuilder_obj: unknown request: %s", showAny(request));
+}
+
+Any StringBuilder_obj1(void *env0, Any param) { 
+    Env_StringBuilder *env = env0;
+    return StringBuilder_obj(env->builderR, env->seqIdR, param); 
+}
+
+Any primMkStringBuilder(Any unused) {
+    int seqId = 0;
+    MALLOC(StringBuilder, builderR, { {}, 0, seqId });
+    sb_init(&builderR->sb);
+    int seqIdR = seqId;
+    MALLOC(Env_StringBuilder, newEnv, { Env_StringBuilder_Header, builderR, seqIdR });
+    Any builderObj = adaptClosure_Any_to_Any(StringBuilder_obj1, newEnv);
+    return builderObj;
+}
+
+
 
 typedef struct {
     OrderedMapPtr map;
@@ -2867,6 +5017,16 @@ Header Env_AssocP_Header =
         // TODO ? populate these fields ?
     } } };
 
+// String keys are interned, so most key comparisons are a pointer compare.
+Any assoc_internKey(Any key) {
+    key = any_to_any(key);
+    if (key.repr->tag == Repr_Str) {
+        Str str = *(Str*) key.value;
+        return str.isStatic ? key : any_from_str(str_intern(str));
+    }
+    return key;
+}
+
 Any mkAssocObj_persistent2(void *env, Str param);
 
 Any mkAssocObj_persistent(AssocPtr state, Str reqName, Any reqArgsAny) {
@@ -2876,6 +5036,7 @@ Any mkAssocObj_persistent(AssocPtr state, Str reqName, Any reqArgsAny) {
     if (strEq(req, STR_get)) {
         Any key = {};
         any_matchTuple1(reqArgs, &key);
+        key = assoc_internKey(key);
         Any result = omap_get(assoc->map, key);
         if (result.repr == NULL) {
             result = any_nil();
@@ -2893,6 +5054,7 @@ Any mkAssocObj_persistent(AssocPtr state, Str reqName, Any reqArgsAny) {
         Any key = {};
         Any val = {};
         any_matchTuple2(keyVal, &key, &val);
+        key = assoc_internKey(key);
         // copy-on-EVERY-write
         OrderedMapPtr om = omap_copy(assoc->map);
         if (any_isNil(val)) {
@@ -2947,7 +5109,7 @@ Any mkAssocObj_persistent1(void *env0, Any param) {
 Any mkAssocObj_persistent2(void *env0, Str param) { 
     Env_AssocP *env = env0;
     AssocPtr state = env->state;
-    Str reqName = param;
+    Str reqName = str_intern(param);
     MALLOC(Env_AssocP, newEnv, { Env_AssocP_Header, state, reqName });
     return adaptClosure_Any_to_Any(mkAssocObj_persistent1, newEnv); 
 }
@@ -2961,6 +5123,7 @@ Any primAssoc1MkPersistent(Any elemsAny) {
     while (any_iterate(&it, &elem)) {
         Any key = {}, val = {};
         any_matchTuple2(elem, &key, &val);
+        key = assoc_internKey(key);
         omap_set(om, key, val);
     }
     int seqId = 0;
@@ -3003,6 +5166,7 @@ Any mkAssocObj_ephemeral(AssocPtr state, int seqIdR, Str reqName, Any reqArgsAny
     if (strEq(req, STR_get)) {
         Any key = {};
         any_matchTuple1(reqArgs, &key);
+        key = assoc_internKey(key);
         Any result = omap_get(assoc->map, key);
         if (result.repr == NULL) {
             result = any_nil();
@@ -3019,6 +5183,7 @@ Any mkAssocObj_ephemeral(AssocPtr state, int seqIdR, Str reqName, Any reqArgsAny
         Any key = {};
         Any val = {};
         any_matchTuple2(keyVal, &key, &val);
+        key = assoc_internKey(key);
         // update the map in-place
         OrderedMapPtr om = assoc->map;
         if (any_isNil(val)) {
@@ -3080,7 +5245,7 @@ Any mkAssocObj_ephemeral2(void *env0, Any param) {
     Env_AssocE *env = env0;
     AssocPtr state = env->state;
     int seqId = env->seqIdR;
-    Str reqName = any_to_str(param);
+    Str reqName = str_intern(any_to_str(param));
     MALLOC(Env_AssocE, newEnv, { Env_AssocE_Header, state, seqId, reqName });
     return adaptClosure_Any_to_Any(mkAssocObj_ephemeral1, newEnv); 
 }
@@ -3093,6 +5258,7 @@ Any primAssoc1MkEphemeral(Any elemsAny) {
     while (any_iterate(&it, &elem)) {
         Any key = {}, val = {};
         any_matchTuple2(elem, &key, &val);
+        key = assoc_internKey(key);
         omap_set(om, key, val);
     }
     int seqId = 0;
@@ -3109,30 +5275,38 @@ Any primAssoc1MkEphemeral(Any elemsAny) {
 
 Any tryReadFile(Str filenameStr) {
     Any result = any_nil();
-    const char *filenameCStr = filenameStr.data;
+    const char *filenameCStr = str_cstr(filenameStr);
     char buffer [4096];
     FILE *file = fopen(filenameCStr, "rb");
     if (file == NULL || ferror(file)) {
         goto exit;
     }
-    Any chunks = any_nil();
+    // when the size is known, read the file straight into the result, rather than concatenating chunks
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+        char *contents = malloc_str_or_panic(size + 1);
+        size_t len = fread(contents, sizeof(char), size, file);
+        if (ferror(file)) {
+            goto exit;
+        }
+        contents[len] = '\0';
+        result = any_pair(any_from_str((Str){false, false, utf8_isMultibyte(contents, len), 0, len, contents}), any_nil());
+        goto exit;
+    }
+    rewind(file);
+    ListBuilder chunks;
+    listBuilder_init(&chunks, &strRepr.base);
     size_t numCharsRead = 0;
     do {
         numCharsRead = fread(buffer, sizeof(char), sizeof(buffer), file);
         if (ferror(file)) {
             goto exit;
         }
-        chunks = any_pair(any_from_str(str_new(buffer, numCharsRead)), chunks);
+        Str chunk = str_new(buffer, numCharsRead);
+        listBuilder_append(&chunks, &chunk);
     }
     while (numCharsRead == sizeof(buffer));
-    Any it = chunks;
-    // reverse the chunks
-    chunks = any_nil();
-    Any chunk = {};
-    while (any_iterate(&it, &chunk)) {
-        chunks = any_pair(chunk, chunks);
-    }
-    ListStr chunks_listStr = { any_to_list(&strRepr.base, chunks) };
+    ListStr chunks_listStr = { listBuilder_seal(&chunks, (List){}) };
     result = any_pair(any_from_str(strCat(chunks_listStr)), any_nil());
     exit:
     if (file != NULL) {
@@ -3143,12 +5317,16 @@ Any tryReadFile(Str filenameStr) {
 }
 
 void writeFile(Str filenameStr, Str contents) {
-    const char *filenameCStr = filenameStr.data;
+    const char *filenameCStr = str_cstr(filenameStr);
     FILE *file = fopen(filenameCStr, "wb");
     if (ferror(file)) {
         goto exit;
     }
-    fwrite(contents.data, sizeof(char), contents.len, file);
+    StrChunks chunks = strChunks_init(contents);
+    Str chunk;
+    while (strChunks_next(&chunks, &chunk)) {
+        fwrite(chunk.data, sizeof(char), chunk.len, file);
+    }
     if (ferror(file)) {
         goto exit;
     }
@@ -3169,10 +5347,118 @@ Header Env_ioDo_Header =
     } } };
 
 
+// GC metrics.
+// The number of collections, the time spent in them, and the heap size/usage are collected throughout the run.
+// Setting the FERRUM_GC_METRICS environment variable enables reporting them:
+//   - at exit (from printDiagnostics),
+//   - on receipt of SIGUSR1 (at the next ioDoPrim request),
+//   - every N ioDoPrim requests, where N is the value of FERRUM_GC_METRICS (zero disables this).
+// The heap is also sampled at every ioDoPrim request, to track its peak size.
+// The environment variables FERRUM_GC_INITIAL_HEAP_SIZE (in bytes) and FERRUM_GC_FREE_SPACE_DIVISOR 
+//   are passed on to the GC at start-up.
+// Define RUNTIME_GC_METRICS as 0 to remove this entirely.
+
+#if RUNTIME_GC_METRICS
+bool gcMetricsReport = false;
+long gcMetricsInterval = 0;
+long gcMetricsRequests = 0;
+volatile sig_atomic_t gcMetricsSignalled = 0;
+
+long gcCount = 0;
+double gcPauseStart = 0;
+double gcPauseTotal = 0;
+double gcPauseMax = 0;
+size_t gcPeakHeapSize = 0;
+
+double gcMetrics_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// called by the GC, this must not allocate
+void gcMetrics_onEvent(GC_EventType event) {
+    switch (event) {
+        case GC_EVENT_START:
+            gcPauseStart = gcMetrics_now();
+            break;
+        case GC_EVENT_END: {
+            double pause = gcMetrics_now() - gcPauseStart;
+            gcCount += 1;
+            gcPauseTotal += pause;
+            if (pause > gcPauseMax) {
+                gcPauseMax = pause;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void gcMetrics_onSignal(int signum) {
+    gcMetricsSignalled = 1;
+}
+
+void gcMetrics_sample() {
+    size_t heapSize = GC_get_heap_size();
+    if (heapSize > gcPeakHeapSize) {
+        gcPeakHeapSize = heapSize;
+    }
+}
+
+void gcMetrics_print(const char *reason) {
+    if (!gcMetricsReport) {
+        return;
+    }
+    gcMetrics_sample();
+    fprintf(stderr, "GC Metrics (%s): collections %ld, pause total %.3f s, pause max %.3f ms, "
+        "heap %zu, heap peak %zu, free %zu, allocated since GC %zu, allocated total %zu\n",
+        reason, gcCount, gcPauseTotal, gcPauseMax * 1e3,
+        GC_get_heap_size(), gcPeakHeapSize, GC_get_free_bytes(), GC_get_bytes_since_gc(), GC_get_total_bytes());
+    fflush(stderr);
+}
+
+// called once per ioDoPrim request
+void gcMetrics_request() {
+    gcMetricsRequests += 1;
+    gcMetrics_sample();
+    if (gcMetricsSignalled) {
+        gcMetricsSignalled = 0;
+        gcMetrics_print("signal");
+    }
+    if (gcMetricsInterval != 0 && gcMetricsRequests % gcMetricsInterval == 0) {
+        gcMetrics_print("sample");
+    }
+}
+
+void gcMetrics_init() {
+    const char *initialHeapSize = getenv("FERRUM_GC_INITIAL_HEAP_SIZE");
+    if (initialHeapSize != NULL) {
+        GC_expand_hp(strtoul(initialHeapSize, NULL, 10));
+    }
+    const char *freeSpaceDivisor = getenv("FERRUM_GC_FREE_SPACE_DIVISOR");
+    if (freeSpaceDivisor != NULL) {
+        GC_set_free_space_divisor(strtoul(freeSpaceDivisor, NULL, 10));
+    }
+    GC_set_on_collection_event(gcMetrics_onEvent);
+    const char *report = getenv("FERRUM_GC_METRICS");
+    if (report != NULL) {
+        gcMetricsReport = true;
+        gcMetricsInterval = strtol(report, NULL, 10);
+        signal(SIGUSR1, gcMetrics_onSignal);
+    }
+}
+#endif
+
+
 Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
     Any ioState = any_nil();
     Any exitValue = {};
     while (exitValue.repr == NULL) {
+#if RUNTIME_GC_METRICS
+        gcMetrics_request();
+#endif
         Any req = {};
         Any kResp = {};
         any_matchTuple2(reqResp, &req, &kResp);
@@ -3180,11 +5466,11 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
         Any reqArgs = {};
         any_matchPair(req, &reqName, &reqArgs);
         Any result = any_nil();
-        Str reqNameStr = any_to_str(reqName);
+        Str reqNameStr = str_intern(any_to_str(reqName));
         // fprintf(stderr, "C_IO: "); printRef(stderr, req); fprintf(stderr, "\n"); fflush(stderr);
         // fprintf(stderr, "C_IO: %s\n", showRef(req)); fflush(stderr);
         // fprintf(stderr, "C_IO: %s\n", showRef(head(req))); fflush(stderr);
-        if (strEq(reqNameStr, strC("readFile"))) {
+        if (strEq(reqNameStr, STR_INTERN("readFile"))) {
             Any filename = any_head(reqArgs);
             Str filenameStr = any_to_str(filename);
             fprintf(stderr, "C_IO: readFile %s\n", showAny(filename)); fflush(stderr);
@@ -3194,7 +5480,7 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
             }
             result = any_head(contentsMb);
         } 
-        else if (strEq(reqNameStr, strC("readFile2"))) {
+        else if (strEq(reqNameStr, STR_INTERN("readFile2"))) {
             Any filename = any_head(reqArgs);
             Str filenameStr = any_to_str(filename);
             fprintf(stderr, "C_IO: readFile2 %s\n", showAny(filename)); fflush(stderr);
@@ -3206,7 +5492,7 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
                 result = any_tuple2(any_from_str(strC("Ok")), any_head(contentsMb));
             }
         } 
-        else if (strEq(reqNameStr, strC("writeFile"))) {
+        else if (strEq(reqNameStr, STR_INTERN("writeFile"))) {
             Any filename = {}, contents = {};
             any_matchTuple2(reqArgs, &filename, &contents);
             fprintf(stderr, "C_IO: writeFile %s\n", showAny(filename)); fflush(stderr);
@@ -3215,22 +5501,22 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
             writeFile(filenameStr, contentsStr);
             result = any_nil();
         } 
-        else if (strEq(reqNameStr, strC("print"))) {
+        else if (strEq(reqNameStr, STR_INTERN("print"))) {
             Any arg = {};
             any_matchTuple1(reqArgs, &arg);
             // print on stdout, 
             // printf("C_IO Print "); printRef(stdout, arg); printf("\n");
-            fprintf(stderr, "C_IO: print %s\n", showAny(arg)); fflush(stderr);
-            printf("%s\n", showAny(arg));
+            fprintf(stderr, "C_IO: print "); printAny(stderr, arg); fprintf(stderr, "\n"); fflush(stderr);
+            printAny(stdout, arg); printf("\n");
             // or print on stderr
             // fprintf(stderr, "C_IO Print "); printRef(stderr, arg); fprintf(stderr, "\n"); fflush(stderr);
             result = any_nil();
         } 
-        else if (strEq(reqNameStr, strC("getArgs"))) {
+        else if (strEq(reqNameStr, STR_INTERN("getArgs"))) {
             any_matchNil(reqArgs);
             result = cmdLineArgs;
         } 
-        else if (strEq(reqNameStr, strC("getFerrumDir"))) {
+        else if (strEq(reqNameStr, STR_INTERN("getFerrumDir"))) {
             const char *srcDir = getFeDir();
             if (srcDir == NULL) {
                 result = any_nil();
@@ -3239,11 +5525,11 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
                 result = any_pair(any_from_str(strC(srcDir)), any_nil());
             }
         } 
-        else if (strEq(reqNameStr, strC("getEnvVar"))) {
+        else if (strEq(reqNameStr, STR_INTERN("getEnvVar"))) {
             Any nameAny = {};
             any_matchTuple1(reqArgs, &nameAny);
             Str nameStr = any_to_str(nameAny);
-            const char *name_cstr = nameStr.data;
+            const char *name_cstr = str_cstr(nameStr);
             const char *value = getEnvVar(name_cstr);
             if (value == NULL) {
                 result = any_nil();
@@ -3252,7 +5538,7 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
                 result = any_pair(any_from_str(strC(value)), any_nil());
             }
         } 
-        else if (strEq(reqNameStr, strC("get"))) {
+        else if (strEq(reqNameStr, STR_INTERN("get"))) {
             Any key = {}, mkInitVal = {};
             any_matchTuple2(reqArgs, &key, &mkInitVal);
             Any it = ioState, kv = {};
@@ -3268,7 +5554,7 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
                 result = any_call(mkInitVal, any_nil());
             }
         } 
-        else if (strEq(reqNameStr, strC("set"))) {
+        else if (strEq(reqNameStr, STR_INTERN("set"))) {
             Any keyVal = reqArgs;
             Any key = {}, val = {};
             any_matchTuple2(keyVal, &key, &val);
@@ -3298,7 +5584,7 @@ Any ioDoPrim(Any cmdLineArgs, Any reqResp) {
             ioState = newIoState;
             result = any_nil();
         }
-        else if (strEq(reqNameStr, strC("done")) || strEq(reqNameStr, strC("exit"))) {
+        else if (strEq(reqNameStr, STR_INTERN("done")) || strEq(reqNameStr, STR_INTERN("exit"))) {
             Any arg = {};
             any_matchTuple1(reqArgs, &arg);
             exitValue = arg;
@@ -3326,7 +5612,7 @@ void ioDoAsyncProxy(Any rr) {
     any_matchTuple2(rr, &req, &kResp);
     while (!any_isNil(kResp)) {
         // fprintf(stderr, "CAIO_Request: %s\n", showAny(req));
-        printf("%s\n", showAny(req)); fflush(stdout);
+        printAny(stdout, req); printf("\n"); fflush(stdout);
         char *line = NULL;
         size_t len = 0;
         getline(&line, &len, stdin);
@@ -3335,7 +5621,7 @@ void ioDoAsyncProxy(Any rr) {
         rr = any_call(kResp, resp);
         any_matchTuple2(rr, &req, &kResp);
     }
-    printf("%s\n", showAny(req));
+    printAny(stdout, req); printf("\n");
 }
 
 
@@ -3344,6 +5630,8 @@ typedef struct {
     const char *in;
     const size_t len;
     int pos;
+    // the input outlives the parsed data, so parsed strings can be slices of it
+    bool share;
 } ParseState;
 
 
@@ -3434,9 +5722,22 @@ Any ps_parseInteger(ParseState *ps) {
 }
 
 Any ps_parseString(ParseState *ps) {
+    ps_skipChar(ps, '"');
+    if (ps->share) {
+        // a string without escapes is a slice of the input
+        size_t end = ps->pos;
+        while (end < ps->len && ps->in[end] != '"' && ps->in[end] != '\\') {
+            end += 1;
+        }
+        if (end < ps->len && ps->in[end] == '"') {
+            // the input is taken to be multibyte, so that str_slice checks each slice
+            Str result = str_slice((Str){false, false, true, 0, ps->len, ps->in}, ps->pos, end);
+            ps->pos = end + 1;
+            return any_from_str(result);
+        }
+    }
     StringBuffer sb;
     sb_init(&sb);
-    ps_skipChar(ps, '"');
     while (!ps_trySkipChar(ps, '"')) {
         char c = ps_peekChar(ps);
         ps_takeChar(ps);
@@ -3467,7 +5768,8 @@ Any ps_parseData(ParseState *ps);
 
 Any ps_parseTuple(ParseState *ps) {
     ps_skipChar(ps, '[');
-    Any elems = any_nil();
+    AnyListBuilder elems;
+    anyListBuilder_init(&elems);
     Any tupleTail = any_nil();
     bool first = true;
     while (!ps_trySkipChar(ps, ']')) {
@@ -3485,16 +5787,10 @@ Any ps_parseTuple(ParseState *ps) {
         }
         Any elem = ps_parseData(ps);
         ps_skipWhitespace(ps);
-        elems = any_pair(elem, elems);
+        anyListBuilder_append(&elems, elem);
         first = false;
     }
-    Any it = elems;
-    Any elem = {};
-    elems = tupleTail;
-    while (any_iterate(&it, &elem)) {
-        elems = any_pair(elem, elems);
-    }
-    return elems;
+    return anyListBuilder_finish(&elems, tupleTail);
 }
 
 
@@ -3560,7 +5856,7 @@ Any any_jsEval(Any jsExprRef) {
     Any output = tryReadFile(strC("gen/test4c-jsEval-result.txt"));
     Str out = any_to_str(any_head(output));
     int pos = 0;
-    ParseState ps = { out.data, out.len, 0 };
+    ParseState ps = { out.data, out.len, 0, true };
     Any data = ps_parseData(&ps);
     return data;
 }
@@ -3615,8 +5911,12 @@ Type any_Primitive(Str name) {
 // }
 
 void initPrimitives(int argc, const char *argv[]) {
+#if RUNTIME_GC_METRICS
+    gcMetrics_init();
+#endif
 
-    // hashConsMap = omap_init();
+    str_initSmall();
+    hashConsGlobal = getenv("FERRUM_HASH_CONS") != NULL;
 
     fixCurried = adaptFunction_AnyAny_to_Any(fix);
 
@@ -3773,17 +6073,36 @@ void sb_showRepr(StringBuffer * sb, Repr repr) {
     }
 }
 
+// Opens a nested value, or, once maxDepth is reached, writes an elided placeholder instead.
+bool sb_openBracket(StringBuffer * sb) {
+    if (sb->maxDepth != 0 && sb->depth >= sb->maxDepth) {
+        sb_append(sb, "[...]", 5);
+        return false;
+    }
+    sb->depth += 1;
+    sb_append(sb, "[", 1);
+    return true;
+}
+
+void sb_closeBracket(StringBuffer * sb) {
+    sb->depth -= 1;
+    sb_append(sb, "]", 1);
+}
+
 void sb_showReprData(StringBuffer * sb, Repr repr, const void * data) {
     // fprintf(stderr, "sb_showReprData: %16p - %20s\n", data, showRepr(repr));
+    if (sb->truncated) {
+        return;
+    }
     switch (repr->tag) {
         case Repr_Bool: {
             bool value = *(bool*) data;
-            sb_printf(sb, "%s", value ? "true" : "false");
+            sb_appendCStr(sb, value ? "true" : "false");
             break;
         }
         case Repr_Int: {
             int value = *(int*) data;
-            sb_printf(sb, "%d", value);
+            sb_appendInt(sb, value);
             break;
         }
         case Repr_Str: {
@@ -3793,8 +6112,7 @@ void sb_showReprData(StringBuffer * sb, Repr repr, const void * data) {
         }
         case Repr_Char: {
             Char value = *(Char*) data;
-            Str s = { false, 1, &value.value };
-            sb_showStr(sb, s);
+            sb_showStr(sb, char_to_str(value));
             break;
         }
         case Repr_Func: {
@@ -3822,22 +6140,24 @@ void sb_showReprData(StringBuffer * sb, Repr repr, const void * data) {
             // TODO dont' construct the Any manually
             // Any it = (Any){ &pairRepr.base, data };
             Any it = any_from_value(repr, data);
-            sb_printf(sb, "[");
+            if (!sb_openBracket(sb)) {
+                break;
+            }
             bool first = true;
-            while(any_isPair(it)) {
+            while(any_isPair(it) && !sb->truncated) {
                 Any elem = any_head(it);
                 if (!first) {
-                    sb_printf(sb, ",");
+                    sb_append(sb, ",", 1);
                 }
                 sb_showAny(sb, elem);
                 first = false;
                 it = any_tail(it);
             }
             if (!any_isNil(it)) {
-                sb_printf(sb, ",,");
+                sb_append(sb, ",,", 2);
                 sb_showAny(sb, it);
             }
-            sb_printf(sb, "]");
+            sb_closeBracket(sb);
             break;
         }
         case Repr_List: {
@@ -3846,68 +6166,78 @@ void sb_showReprData(StringBuffer * sb, Repr repr, const void * data) {
             List lp = *(List*) data;
             void * elem = NULL;
             bool first  = true;
-            sb_printf(sb, "[");
-            while(list_iterate(elemRepr, &lp, &elem)) {
+            if (!sb_openBracket(sb)) {
+                break;
+            }
+            while(!sb->truncated && list_iterate(elemRepr, &lp, &elem)) {
                 if (!first) {
-                    sb_printf(sb, ",");
+                    sb_append(sb, ",", 1);
                 }
                 sb_showReprData(sb, elemRepr, elem);
                 first = false;
             }
-            sb_printf(sb, "]");
+            sb_closeBracket(sb);
             break;
         }
         case Repr_Tuple: {
             ReprTuple * repr2 = (ReprTuple *) repr;
-            sb_printf(sb, "[");
+            if (!sb_openBracket(sb)) {
+                break;
+            }
             for (int i=0; i != repr2->schema->numFields; i++) {
                 if (i != 0) {
-                    sb_printf(sb, ",");
+                    sb_append(sb, ",", 1);
                 }
                 Field field = repr2->schema->fields[i];
                 sb_showReprData(sb, field.repr, VOID_PTR_ADD(data, field.offset, 1));
             }
-            sb_printf(sb, "]");
+            sb_closeBracket(sb);
             break;
         }
         case Repr_TupleTail: {
             TupleTail * tt = (TupleTail*) data;
-            sb_printf(sb, "[");
+            if (!sb_openBracket(sb)) {
+                break;
+            }
             for (int i=tt->pos; i != tt->tupleRepr->schema->numFields; i++) {
                 if (i != tt->pos) {
-                    sb_printf(sb, ",");
+                    sb_append(sb, ",", 1);
                 }
                 Field field = tt->tupleRepr->schema->fields[i];
                 sb_showReprData(sb, field.repr, VOID_PTR_ADD(tt->tupleValue, field.offset, 1));
             }
-            sb_printf(sb, "]");
+            sb_closeBracket(sb);
             break;
         }
         case Repr_No:
-            sb_printf(sb, "[]");
+            sb_append(sb, "[]", 2);
             break;
         case Repr_Yes: {
             ReprYes * repr2 = (ReprYes*) repr;
-            sb_printf(sb, "[");
+            if (!sb_openBracket(sb)) {
+                break;
+            }
             sb_showReprData(sb, repr2->elemRepr, data);
-            sb_printf(sb, "]");
+            sb_closeBracket(sb);
             break;
         }
         case Repr_Maybe: {
             ReprMaybe * repr2 = (ReprMaybe*) repr;
             size_t isYesOffset = 0;
             size_t valueOffset = repr2->valueOffset;
-            sb_printf(sb, "[");
+            if (!sb_openBracket(sb)) {
+                break;
+            }
             bool isYes = *(bool*) VOID_PTR_ADD(data, isYesOffset, 1);
             if (isYes) {
                 sb_showReprData(sb, repr2->valueRepr, VOID_PTR_ADD(data, valueOffset, 1));
             }
-            sb_printf(sb, "]");
+            sb_closeBracket(sb);
             break;
         }
         case Repr_Any: {
             Any any = *(Any*) data;
-            sb_showReprData(sb, any.repr, any.value);
+            sb_showReprData(sb, any.repr, ANY_PAYLOAD(any));
             break;
         }
         case Repr_Type:
@@ -3941,7 +6271,7 @@ void sb_showReprData(StringBuffer * sb, Repr repr, const void * data) {
 }
 
 void sb_showAny(StringBuffer * sb, Any a) {
-    sb_showReprData(sb, a.repr, a.value);
+    sb_showReprData(sb, a.repr, ANY_PAYLOAD(a));
 }
 
 
@@ -3960,10 +6290,23 @@ const char * showReprData(Repr repr, const void * data) {
 }
 
 const char * showAny(Any any) {
-    const char * result = showReprData(any.repr, any.value);
+    const char * result = showReprData(any.repr, ANY_PAYLOAD(any));
     return result;
 }
 
+void printAnyLimited(FILE * file, Any any, size_t maxLen, int maxDepth) {
+    StringBuffer sb;
+    sb_initFile(&sb, file);
+    sb.maxLen = maxLen;
+    sb.maxDepth = maxDepth;
+    sb_showAny(&sb, any);
+    sb_closeFile(&sb);
+}
+
+void printAny(FILE * file, Any any) {
+    printAnyLimited(file, any, 0, 0);
+}
+
 const char * showStr(Str s) {
     StringBuffer sb;
     sb_init(&sb);
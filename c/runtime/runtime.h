@@ -14,12 +14,15 @@
 
 typedef struct {
     bool isStatic;
+    bool isRope; // data points to a StrRope, use str_flat (or StrChunks) to access the contents
+    bool isMultibyte; // contains non-ASCII bytes, so positions are not byte offsets (see STR_UTF8)
+    uint32_t hash; // the hash of the contents, cached by str_hash, zero until then
     size_t len;
     const char *data;
 } Str;
 
 typedef struct Char {
-    char value;
+    uint32_t value; // a code point, (a byte, without STR_UTF8)
 } Char;
 
 typedef enum {
@@ -52,6 +55,18 @@ typedef struct {
     // TODO ?     - always allowing a multiple of max_align_t space for the header
     // TODO ?     - creating a new boxed struct type for every possible payload type
     // size_t align;
+
+    // An immediate Repr stores its payload directly in the Any.value field, 
+    //   rather than Any.value pointing to a separately allocated copy.
+    // Only small scalar datums (Bool, Int, Char) have immediate Reprs.
+    // The same datum may still be referred to by pointer (such as an element within a List or Tuple),
+    //   in which case the non-immediate Repr is used.
+    bool immediate;
+
+    // A pointer-free Repr has a payload that never contains a pointer the GC needs to trace.
+    // Payloads of such Reprs (including List element buffers) are allocated atomically.
+    // The default (false) is always safe.
+    bool pointerFree;
 } ReprBase;
 
 typedef const ReprBase *Repr;
@@ -128,6 +143,7 @@ typedef struct {
     ReprBase base;
 } ReprBool;
 extern ReprBool boolRepr;
+extern ReprBool boolImmRepr;
 
 typedef struct {
     ReprBase base;
@@ -135,6 +151,7 @@ typedef struct {
     int byteWidth;
 } ReprInteger;
 extern ReprInteger intRepr;
+extern ReprInteger intImmRepr;
 
 typedef struct {
     ReprBase base;
@@ -145,6 +162,7 @@ typedef struct {
     ReprBase base;
 } ReprChar;
 extern ReprChar charRepr;
+extern ReprChar charImmRepr;
 
 typedef struct {
     ReprBase base;
@@ -333,6 +351,9 @@ typedef struct Schema {
     size_t size;
     size_t numFields;
     Field *fields;
+    // the precise GC descriptor (a GC_descr) for values with this Schema, computed lazily by schema_gcDescr
+    bool gcDescrReady;
+    uintptr_t gcDescr;
 } Schema;
 
 typedef struct Header {
@@ -368,6 +389,8 @@ typedef struct ListSegment {
     int numElems;
     void *elems;
     struct List tail;
+    // the length of the tail, so a list's length is found without walking it
+    int tailLength;
     // purely for diagnostic and debugging purposes
     //   alternatively, if the Header contains a ReprList, then this will also have the elemRepr
     Repr elemRepr;
@@ -405,6 +428,7 @@ extern ReprObject objectRepr;
 typedef struct ListStr ListStr;      extern const ReprList listStr;
 typedef struct MaybeChar MaybeChar;  extern const ReprMaybe maybeChar;
 typedef struct ListChar ListChar;    extern const ReprList listChar;
+typedef struct ListInt ListInt;      extern const ReprList listInt;
 
 // typedef struct ObjectMk ObjectMk;    extern const ReprClos objectMk;
 typedef struct FunAnyAny FunAnyAny;  extern const ReprClos funAnyAny;
@@ -420,6 +444,15 @@ typedef struct FunAnyAny FunAnyAny;  extern const ReprClos funAnyAny;
 
 
 Str strStatic(const char *val, size_t len);
+Str str_small(const char *val, size_t len);
+Str str_intern(Str str);
+void str_internStatic(Str *str);
+Str str_slice(Str s, size_t start, size_t end);
+const char *str_cstr(Str s);
+Str str_flat(Str s);
+uint32_t str_hash(Str *str);
+Str char_to_str(Char ch);
+bool str_to_char(Str s, Char *ch);
 
 
 List list_prepend1 (Repr elemRepr, List lp, void * elem);
@@ -430,15 +463,33 @@ bool list_isPair(List lp);
 void * list_head(Repr elemRepr, List lp);
 List list_tail(Repr elemRepr, List lp);
 
-// TODO ? a more imperative interface, update the listPtr in place, 
-// TODO ?   make generated pattern matching code less cluttered / more readable ?
+// A more imperative interface, the listPtr is updated in place, 
+//   this makes generated pattern matching code less cluttered / more readable.
 void   list_frontPush(Repr elemRepr, List * lp, int numElems, void * elems);
 void * list_frontPop (Repr elemRepr, List * lp);
+void * list_span     (Repr elemRepr, List * lp, int * count);
+void * list_spanAt   (Repr elemRepr, List lp, int * count);
+List   list_spanRest (List lp);
 
 int list_length(List lp);
+void * list_at(Repr elemRepr, List lp, int pos);
 List list_reverse(Repr elemRepr, List lp);
+List list_alloc_chunked(Repr elemRepr, size_t len, List tail);
 void * list_lookup(Repr keyValRepr, Repr valMbRepr, Str key, List lp);
 
+// Builds a List front-to-back, (see listBuilder_alloc).
+typedef struct {
+    Repr elemRepr;
+    List head;
+    ListSegment *last;
+    int length;
+} ListBuilder;
+
+void   listBuilder_init  (ListBuilder * lb, Repr elemRepr);
+void * listBuilder_alloc (ListBuilder * lb);
+void   listBuilder_append(ListBuilder * lb, void * elem);
+List   listBuilder_seal  (ListBuilder * lb, List tail);
+
 
 TupleTail tuple_tail(Repr tupleRepr, int pos, const void * value);
 
@@ -464,6 +515,9 @@ const char * getEnvVar(const char *name);
 Any any_head(Any);
 Any any_tail(Any);
 bool any_isNil(Any);
+Any any_hashCons(Any a);
+bool any_tryHash(Any a, uint64_t *hash);
+uint64_t any_hash(Any a);
 bool any_isPair(Any);
 
 bool any_isBool(Any);
@@ -504,6 +558,7 @@ Any any_from_union(ReprUnion const * repr, const void *a);
 void any_to_value(Any in, const Repr outRepr, void *outValue);
 bool any_try_to_value(Any in, const Repr outRepr, void *outValue);
 Any any_from_value(const Repr inRepr, const void * inValue);
+Any any_from_immediate(const Repr immRepr, const void * inValue);
 
 const void * any_to_value_ptr(Any in, const Repr outRepr);
 
@@ -572,12 +627,27 @@ int strOrd(Str a);
 Str strChr(int a);
 Str strCharAt(Str a, int b);
 MaybeChar strCharAtMb(Str a, int b);
+Str strSlice(Str a, int b, int c);
+ListStr strSplit(Str delim, Str a);
+int strSpanWhile(Str a, int pos, Str chars);
+int strFindAny(Str a, int pos, Str chars);
+int strIndexOf(Str a, int pos, Str needle);
 bool strEq(Str a, Str b);
 bool str_char_eq(Str a, Char b);
 bool char_eq(Char a, Char b);
 
 Str char_concat (ListChar a);
 
+int intListSum(ListInt a);
+int intListMin(int z, ListInt a);
+int intListMax(int z, ListInt a);
+int intListIndexOf(ListInt a, int x);
+bool intListEq(ListInt a, ListInt b);
+int intListCompare(ListInt a, ListInt b);
+int charListIndexOf(ListChar a, Char x);
+bool charListEq(ListChar a, ListChar b);
+int charListCompare(ListChar a, ListChar b);
+
 
 Any any_loopOne (Any func, Any value);
 Any any_loopTwo (Any value, Any func);
@@ -601,6 +671,7 @@ Type TypeConsFuncStr(Str a);
 Any fix(Any f, Any x);
 
 Any any_show(Any a);
+Any any_showLimited(int maxLen, int maxDepth, Any a);
 Any any_identity(Any a);
 Any any_trace(Any msg, Any val);
 Any any_traceTwo(Any msg, Any k);
@@ -611,6 +682,7 @@ Any any_jsEvalMaybe(Any jsExprRef);
 
 Any primMkArrayFastAccessNoCopy(Any repr, Any elems);
 Any primMkArrayFastAccessSlowCopy(Any repr, Any elems);
+Any primMkStringBuilder(Any unused);
 
 Any primAssoc1MkEphemeral(Any elems);
 Any primAssoc1MkPersistent(Any elems);
@@ -630,27 +702,37 @@ void ioDoAsyncProxy(Any rr);
 
 void printDiagnostics();
 
+// GC metrics, (see RUNTIME_GC_METRICS in runtime.c).
+#ifndef RUNTIME_GC_METRICS
+#define RUNTIME_GC_METRICS 1
+#endif
+void gcMetrics_print(const char *reason);
+
 __attribute__((noreturn))
 void fatalError(const char * fmt, ...);
 
 
-extern const Str STR_break;
-extern const Str STR_continue;
-extern const Str STR_length;
-extern const Str STR_get;
-extern const Str STR_set;
-extern const Str STR_extend;
-extern const Str STR_slice;
-extern const Str STR_snapshot;
-extern const Str STR_persistent;
-extern const Str STR_ephemeral;
-extern const Str STR_copy;
+extern Str STR_break;
+extern Str STR_continue;
+extern Str STR_length;
+extern Str STR_get;
+extern Str STR_set;
+extern Str STR_extend;
+extern Str STR_slice;
+extern Str STR_snapshot;
+extern Str STR_persistent;
+extern Str STR_ephemeral;
+extern Str STR_copy;
 
 
 const char * showStr(Str s);
 const char * showAny(Any a);
 const char * showRepr(Repr repr);
 const char * showReprData(Repr repr, const void * data);
+// Streams the shown value straight to the file, without building it in memory first.
+void printAny(FILE * file, Any a);
+// As printAny, but stops after maxLen bytes, and elides values nested deeper than maxDepth, (zero for no limit).
+void printAnyLimited(FILE * file, Any a, size_t maxLen, int maxDepth);
 
 
 
@@ -660,11 +742,42 @@ const void * mallocValue(Repr repr, const void * value);
 
 
 void *malloc_or_panic(size_t size);
+void *malloc_box_or_panic(size_t size);
+void *malloc_atomic_or_panic(size_t size);
+void *malloc_str_or_panic(size_t size);
+void *malloc_large_or_panic(size_t size);
+void *malloc_repr_or_panic(Repr repr, size_t size);
+void *malloc_schema_or_panic(Schema * schema, size_t size);
+
+// Allocation profiling, (see RUNTIME_ALLOC_PROFILE in runtime.c).
+// Each call records the calling function as the allocation site, unless an outer call already has.
+#ifndef RUNTIME_ALLOC_PROFILE
+#define RUNTIME_ALLOC_PROFILE 0
+#endif
+
+#if RUNTIME_ALLOC_PROFILE
+extern const char *allocSite;
+void allocProfile_dump();
+#define ALLOC_SITE (allocSite = (allocSite != NULL ? allocSite : __func__))
+#define malloc_or_panic(size) (ALLOC_SITE, malloc_or_panic(size))
+#define malloc_box_or_panic(size) (ALLOC_SITE, malloc_box_or_panic(size))
+#define malloc_atomic_or_panic(size) (ALLOC_SITE, malloc_atomic_or_panic(size))
+#define malloc_str_or_panic(size) (ALLOC_SITE, malloc_str_or_panic(size))
+#define malloc_large_or_panic(size) (ALLOC_SITE, malloc_large_or_panic(size))
+#define malloc_repr_or_panic(repr, size) (ALLOC_SITE, malloc_repr_or_panic(repr, size))
+#define malloc_schema_or_panic(schema, size) (ALLOC_SITE, malloc_schema_or_panic(schema, size))
+#endif
 // void *void_ptr_as(const char *typeName, void *ptr);
 
 
 #define MALLOC(type, name, ...) \
-      type *name = malloc_or_panic(sizeof(type)); \
+      type *name = malloc_box_or_panic(sizeof(type)); \
+      *name = (type)__VA_ARGS__;
+
+// As MALLOC, but for structs described by a Schema (such as closure environments),
+//   so the GC can trace just the pointer fields.
+#define MALLOC_SCHEMA(type, name, schema, ...) \
+      type *name = malloc_schema_or_panic(schema, sizeof(type)); \
       *name = (type)__VA_ARGS__;
 
 /*
@@ -51,6 +51,8 @@ async function main() {
 
     let outputFilename: string | null = null
     let projectFilename: string | null = null
+    // attribute allocations to sites and Reprs (see RUNTIME_ALLOC_PROFILE in runtime.c)
+    let allocProfile = false
 
     for (const { name, value } of cmdLine.opts) {
         switch (name) {
@@ -96,6 +98,9 @@ async function main() {
                 }
                 outputFilename = value
                 break;
+            case 'alloc-profile':
+                allocProfile = true
+                break;
             default:
                 throw new Error(`unknown option: ${name}`)
         }
@@ -203,6 +208,7 @@ async function main() {
                     "-fno-omit-frame-pointer",
                     "-Wall", ...ignore.map(ig => `-Wno-${ig}`),
                     "-Werror",
+                    ...(allocProfile ? ["-DRUNTIME_ALLOC_PROFILE=1"] : []),
                     `-o gen/${outputFileExe}`,
                     "-I ../c/runtime",
                     "-lgc",
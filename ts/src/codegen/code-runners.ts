@@ -373,7 +373,9 @@ class CodeRunnerC implements CodeRunner {
             `    Any r = results;`,
             `    while (any_isPair(r)) {`,
             `        Any testResult = any_head(r);`,
-            `        printf("${testOutputPrefix}%s\\n", showAny(testResult));`,
+            `        printf("${testOutputPrefix}");`,
+            `        printAny(stdout, testResult);`,
+            `        printf("\\n");`,
             `        r = any_tail(r);`,
             `    }`,
             ``,
@@ -1,10 +1,10 @@
 import { assert } from "../utils/assert.js"
 import { equalObjects } from "../utils/equal-objects.js"
-import { DeclTypeBidir, ExprTypeBidir, VarSet, VarTypeBidir, eList, eDatum, exprFreeVars } from "../syntax/expr.js"
+import { DeclTypeBidir, ExprTypeBidir, VarSet, VarTypeBidir, eList, eDatum, exprFreeVars, exprTour, isLambdaExpr } from "../syntax/expr.js"
 import { locContains, showLoc } from "../syntax/token.js"
 import { Type, typeHd, typeTl, typeDom, anyT, typeRng, ttiIsFalse, tiStructuralRelComp, strT, collectUnionTypes, typeIntersect0, pairT, intersectTypes, evalTypeAnnot, disjoinTypes, typeContainsTypeVar, applyTypes, typeFreeVars, substType, voidT, knownInhabited, collectIntersectTypes, funT, showType2, typeTupleMap, singleT } from "../tree/types.js"
 import { MemoData, MemoMap, mk_MemoData } from "../tree/memoize.js"
-import { isAlphanum, isAlphanumUS } from "../syntax/scan.js"
+import { isAlphanum } from "../syntax/scan.js"
 import { Env, evalNode } from "../tree/eval.js"
 
 // const USE_MIXINS = false
@@ -47,6 +47,7 @@ export type CStmtT<T> =
     | T & { tag: "CIfElse", cond: CExprT<T>, then: CStmtsT<T>, else: CStmtsT<T> }
     | T & { tag: "CWhile", cond: CExprT<T>, body: CStmtsT<T> }
     | T & { tag: "CDoWhile", body: CStmtsT<T>, cond: CExprT<T> }
+    | T & { tag: "CFor", ty: CType, var: CVarT<T>, init: CExprT<T>, cond: CExprT<T>, step: CExprT<T>, body: CStmtsT<T> }
     | T & { tag: "CReturn", expr: CExprT<T> }
     | T & { tag: "CCommentStmt", comment: string }
     | T & { tag: "CBreak" }
@@ -201,6 +202,34 @@ function rSingle(ty: CType, singleReprExpr: CExpr, value: string): CReprSingle {
     return { tag: "Single", singleCType: ty, reprC: singleReprExpr, value: value }
 }
 
+// A pointer-free repr has a payload the GC never needs to scan for pointers.
+// This is emitted into the ReprBase, so the runtime can allocate such payloads atomically.
+function reprPointerFree(repr: CRepr): boolean {
+    switch (repr.tag) {
+        case "Nil":
+        case "Bool":
+        case "Int":
+        case "Char":
+        case "Type":
+        case "Single":
+            return true
+        case "Tuple":
+            return repr.elemReprs.every(reprPointerFree)
+        case "Union":
+            return repr.altReprs.every(reprPointerFree)
+        case "Maybe":
+        case "Yes":
+            return reprPointerFree(repr.elemRepr)
+        default:
+            return false
+    }
+}
+
+// The trailing fields of a ReprBase aggregate: { tag, size, immediate, pointerFree }
+function reprBaseFlags(pointerFree: boolean): CExpr[] {
+    return [cCode("false"), cCode(pointerFree ? "true" : "false")]
+}
+
 // a CValue is an instance of a CRepr
 type CValue =
     { tag: "VVar", var: CVar }
@@ -806,6 +835,12 @@ export class CBuilder {
     staticStrings: { [_: string]: CVarRepr } = {}
     // globalAdaptedVars: AdaptedVars = memoData.mkMemoMap()
     pendingReprCodeGen: CRepr[] = []
+    // let-bound lambdas whose closure environments can be allocated in the C stack-frame (see findStackEnvLambdas)
+    // This is shared, not copied, by clone.
+    //   Membership depends only on the lambda's enclosing let-scope in the AST, not on any builder state,
+    //   so a lambda is added with the same answer however many times, and in whichever clone, its enclosing function is generated.
+    //   Each lambda node has exactly one enclosing function body, and is only ever generated as part of that body's C function.
+    stackEnvLambdas: Set<ExprTypeBidir> = new Set()
 
     memoMaps: CBuilderMemoMaps = {
         // funcTypeMemo3: memoData.mkMemoMap(),
@@ -837,6 +872,7 @@ export class CBuilder {
     repr_ListStr: CRepr
     repr_MaybeChar: CRepr
     repr_ListChar: CRepr
+    repr_ListInt: CRepr
     // repr_ObjectMk: CRepr
     repr_FunAnyAny: CRepr
 
@@ -852,6 +888,7 @@ export class CBuilder {
         this.repr_ListStr = createListRepr(this, rStr, "ListStr")
         this.repr_MaybeChar = createMaybeRepr(this, rChar, "MaybeChar")
         this.repr_ListChar = createListRepr(this, rChar, "ListChar")
+        this.repr_ListInt = createListRepr(this, rInt, "ListInt")
         // this.repr_ObjectMk = createClosRepr(this, [rAny], rObject, "ObjectMk")
         this.repr_FunAnyAny = createClosRepr(this, [rAny], rAny, "FunAnyAny")
     }
@@ -867,6 +904,7 @@ export class CBuilder {
         that.init = this.init.slice()
         that.envC = { ...this.envC }
         that.pendingReprCodeGen = this.pendingReprCodeGen.slice()
+        that.stackEnvLambdas = this.stackEnvLambdas
 
         // shallow-copy all the memo-maps
         let mmEntries: [string, MemoMap<any, any>][] = Object.entries(this.memoMaps)
@@ -1059,30 +1097,14 @@ export class CBuilder {
             this.ctxStack[depth - 1][0].push(...newStmts)
         }
     }
-    staticString(value: string): CVarRepr {
-        if (value in this.staticStrings) {
-            return this.staticStrings[value]
-        }
-        else {
-            let nameHint = "STR_"
-            for (let i = 0; i != value.length && i < 40; i++) {
-                let ch = value.charAt(i)
-                let code = ch.charCodeAt(0)
-                if (code < 0 || code > 127) {
-                    throw new Error(`unexpected non-ASCII character (${code}, ${JSON.stringify(ch)})`)
-                }
-                if (isAlphanumUS(ch)) {
-                    nameHint = nameHint + ch
-                }
-            }
-            let stringVar = this.freshVar(rStr, nameHint, 0)
-            this.addGlobalStmts("AuxC", [cVarDecl(tConst(reprToCType(stringVar.repr)), stringVar, cAggregateConst([cCode("true"), cInt(value.length), cStr(value)]))])
-            this.staticStrings[value] = stringVar
-            return stringVar
-        }
 
-    }
+}
 
+// The fields of a static Str, its length is in (UTF-8) bytes.
+function staticStrFields(value: string): CExpr[] {
+    let len = new TextEncoder().encode(value).length
+    let isMultibyte = len !== value.length
+    return [cCode("true"), cCode("false"), cCode(isMultibyte ? "true" : "false"), cInt(0), cInt(len), cStr(value)]
 }
 
 function stringToNameHint(maxLen: number, unprintableChar: string, value: string): string {
@@ -1090,10 +1112,6 @@ function stringToNameHint(maxLen: number, unprintableChar: string, value: string
     let prevPrintable = false
     for (let i = 0; i != value.length && i < maxLen; i++) {
         let ch = value.charAt(i)
-        let code = ch.charCodeAt(0)
-        if (code < 0 || code > 127) {
-            throw new Error(`unexpected non-ASCII character (${code}, ${JSON.stringify(ch)})`)
-        }
         let isPrintable = isAlphanum(ch)
         if (isPrintable) {
             nameHint += ch
@@ -1116,7 +1134,10 @@ function buildCommonString(cb: CBuilder, strs: string[]) {
     strs.forEach(s => {
         let strVar = cb.namedVar(rStr, `STR_${s}`)
         cb.staticStrings[s] = strVar
-        cb.addGlobalStmts("AuxC", [cVarDecl(tConst(reprToCType(strVar.repr)), strVar, cAggregateConst([cCode("true"), cInt(s.length), cStr(s)]))])
+        cb.addGlobalStmts("AuxC", [
+            cVarDecl(reprToCType(strVar.repr), strVar, cAggregateConst(staticStrFields(s))),
+            cExprStmt(cCall(cCode("str_internStatic"), [cAddrOf(strVar)])),
+        ])
     })
 }
 
@@ -1202,10 +1223,25 @@ let prims: CPrims = {
     "jsStrJoin": erPrim(primCb, "strJoin", [rStr, primCb.repr_ListStr], rStr),
     "strCharAt": erPrim(primCb, "strCharAt", [rStr, rInt], rStr),
     "strCharAtMb": erPrim(primCb, "strCharAtMb", [rStr, rInt], primCb.repr_MaybeChar),
+    "strSlice": erPrim(primCb, "strSlice", [rStr, rInt, rInt], rStr),
+    "strSplit": erPrim(primCb, "strSplit", [rStr, rStr], primCb.repr_ListStr),
+    "strSpanWhile": erPrim(primCb, "strSpanWhile", [rStr, rInt, rStr], rInt),
+    "strFindAny": erPrim(primCb, "strFindAny", [rStr, rInt, rStr], rInt),
+    "strIndexOf": erPrim(primCb, "strIndexOf", [rStr, rInt, rStr], rInt),
     "strChr": erPrim(primCb, "strChr", [rInt], rStr),
     "strOrd": erPrim(primCb, "strOrd", [rStr], rInt),
     "char_concat": erPrim(primCb, "char_concat", [primCb.repr_ListChar], rStr),
 
+    "intListSum": erPrim(primCb, "intListSum", [primCb.repr_ListInt], rInt),
+    "intListMin": erPrim(primCb, "intListMin", [rInt, primCb.repr_ListInt], rInt),
+    "intListMax": erPrim(primCb, "intListMax", [rInt, primCb.repr_ListInt], rInt),
+    "intListIndexOf": erPrim(primCb, "intListIndexOf", [primCb.repr_ListInt, rInt], rInt),
+    "intListEq": erPrim(primCb, "intListEq", [primCb.repr_ListInt, primCb.repr_ListInt], rBool),
+    "intListCompare": erPrim(primCb, "intListCompare", [primCb.repr_ListInt, primCb.repr_ListInt], rInt),
+    "charListIndexOf": erPrim(primCb, "charListIndexOf", [primCb.repr_ListChar, rChar], rInt),
+    "charListEq": erPrim(primCb, "charListEq", [primCb.repr_ListChar, primCb.repr_ListChar], rBool),
+    "charListCompare": erPrim(primCb, "charListCompare", [primCb.repr_ListChar, primCb.repr_ListChar], rInt),
+
     "loop1": erPrim(primCb, "any_loopOne", [rAny, rAny], rAny),
     "loop2": erPrim(primCb, "any_loopTwo", [rAny, rAny], rAny),
 
@@ -1221,10 +1257,12 @@ let prims: CPrims = {
     "tail": erPrim(primCb, "any_tail", [rAny], rAny),
 
     "castT": erPrim(primCb, "any_identity", [rAny], rAny),
+    "hashCons": erPrim(primCb, "any_hashCons", [rAny], rAny),
     "trace": erPrim(primCb, "any_trace", [rAny, rAny], rAny),
     "trace2": erPrim(primCb, "any_traceTwo", [rAny, rAny], rAny),
     "show": erPrim(primCb, "any_show", [rAny], rAny),
     "show2": erPrim(primCb, "any_show", [rAny], rAny),
+    "showLimited": erPrim(primCb, "any_showLimited", [rInt, rInt, rAny], rAny),
     "showType": erPrim(primCb, "any_show", [rAny], rAny),
     "error": erPrim(primCb, "any_error", [rAny], rAny),
 
@@ -1235,6 +1273,7 @@ let prims: CPrims = {
 
     "primMkArrayFastAccessNoCopy": erPrim(primCb, "primMkArrayFastAccessNoCopy", [rAny, rAny], rAny),
     "primMkArrayFastAccessSlowCopy": erPrim(primCb, "primMkArrayFastAccessSlowCopy", [rAny, rAny], rAny),
+    "primMkStringBuilder": erPrim(primCb, "primMkStringBuilder", [rAny], rAny),
 
     "primAssoc1MkEphemeral": erPrim(primCb, "primAssoc1MkEphemeral", [rAny], rAny),
     "primAssoc1MkPersistent": erPrim(primCb, "primAssoc1MkPersistent", [rAny], rAny),
@@ -1297,6 +1336,7 @@ function cIf(cond: CExprOrCExprRepr, then: CStmts): CStmt { return { tag: "CIf",
 function cIfElse(cond: CExprOrCExprRepr, then: CStmts, els: CStmts): CStmt { return { tag: "CIfElse", cond: getExpr(cond), then: then, else: els } }
 function cWhile(cond: CExprOrCExprRepr, body: CStmts): CStmt { return { tag: "CWhile", cond: getExpr(cond), body: body } }
 function cDoWhile(body: CStmts, cond: CExprOrCExprRepr): CStmt { return { tag: "CDoWhile", body: body, cond: getExpr(cond) } }
+function cFor(ty: CType, varC: CVarOrCVarRepr, init: CExprOrCExprRepr, cond: CExprOrCExprRepr, step: CExprOrCExprRepr, body: CStmts): CStmt { return { tag: "CFor", ty: ty, var: getVar(varC), init: getExpr(init), cond: getExpr(cond), step: getExpr(step), body: body } }
 function cReturn(expr: CExprOrCExprRepr): CStmt { return { tag: "CReturn", expr: getExpr(expr) } }
 function cCommentStmt(comment: string): CStmt & CDecl { return { tag: "CCommentStmt", comment: comment } }
 function cBreak(): CStmt { return { tag: "CBreak" } }
@@ -1527,9 +1567,38 @@ function cgc_pat_mat(cb: CBuilder, ty: Type, varC: CVarRepr, pat: ExprTypeBidir,
                         return ok
                     }
                     case "List": {
-                        // TODO ? we can just use a list-length check here, and avoid lots of isPair checks ?
                         let tyL = ty
                         let fieldR = varC.repr.elemRepr
+                        if (pat.tail === null) {
+                            // An exact-length pattern needs a single length check, (lengths are O(1)), 
+                            //   rather than an isPair check per element,
+                            //   then each element is accessed by position.
+                            let tyN = ty
+                            let lengthKnown = true
+                            for (let i = 0; i !== pat.exprs.length; i++) {
+                                lengthKnown &&= tyN.tag === "TPair" || (tyN.tag === "TAs" && tyN.type.tag === "TPair")
+                                tyN = typeTl(tyN)
+                            }
+                            lengthKnown &&= tyN.tag === "TNil"
+                            if (lengthKnown) {
+                                // see the comment in the "Nil" case below, a statement is needed
+                                cb.addStmts([cCommentStmt(`assert (length(${varC.expr.name}) == ${pat.exprs.length})`)])
+                            }
+                            else {
+                                let cond = cOp("!=", [cCall(cCode("list_length"), [cField(varC, "elems")]), cInt(pat.exprs.length)])
+                                cb.addStmts([cIf(cond, failStmts)])
+                            }
+                            let ok = true
+                            pat.exprs.forEach((p, i) => {
+                                let hdVar = cb.freshVar(fieldR, rootPatName(p))
+                                let elem = cCall(cCode("list_at"), [reprToReprExpr(fieldR), cField(varC, "elems"), cInt(i)])
+                                cb.addStmts([cDeclConst(hdVar, cOp("*_", [cCast(tPtr(reprToCType(fieldR)), elem)]))])
+                                let tyE = typeHd(tyL)
+                                ok &&= cg(tyE, hdVar, p)
+                                tyL = typeTl(tyL)
+                            })
+                            return ok
+                        }
                         let listVar = cb.freshVar(varC.repr)
                         cb.addStmts([cDeclVar(listVar, varC)])
                         let ok = true
@@ -1543,8 +1612,7 @@ function cgc_pat_mat(cb: CBuilder, ty: Type, varC: CVarRepr, pat: ExprTypeBidir,
                             }
                             let hdVar = cb.freshVar(fieldR, rootPatName(p))
                             let varTy = reprToCType(reprSimplify(fieldR))
-                            cb.addStmts([cDeclConst(hdVar, cg_head(cb, listVar))])
-                            cb.addStmts([cAssignStmt(listVar, cg_tail(cb, listVar))])
+                            cb.addStmts([cDeclConst(hdVar, cg_frontPop(cb, listVar))])
                             let tyE = typeHd(tyL)
                             ok &&= cg(tyE, hdVar, p)
                             tyL = typeTl(tyL)
@@ -2186,6 +2254,85 @@ function repr_codegen(cb: CBuilder, repr: CRepr) {
 }
 
 
+// The number of parameters in the native function generated for a lambda (see cgc_lambda3)
+function lambdaArity(lam: ExprTypeBidir): number {
+    let arity = 0
+    let e = lam
+    while (e.tag === "ELambda") {
+        arity++
+        e = e.body
+    }
+    if (e.tag === "ELambdaYes" || e.tag === "ELambdaNo" || e.tag === "ELambdaMaybe") {
+        arity++
+    }
+    return arity
+}
+
+// true, if every use of the variable is as the function in a saturated call, outside of any nested lambda.
+// Every other use (as an argument, in a data-structure, partially applied, captured by a nested lambda, ...)
+//   is treated as an escape.
+// Shadowing is not taken into account, this only makes the check more conservative.
+function varOnlyCalled(name: string, arity: number, exprs: ExprTypeBidir[]): boolean {
+    let ok = true
+    let visit = (e: ExprTypeBidir, inLambda: boolean): undefined => {
+        if (!ok) {
+            return
+        }
+        if (e.tag === "EVar") {
+            if (e.name === name) {
+                ok = false
+            }
+            return
+        }
+        if (e.tag === "EApply") {
+            let numArgs = 0
+            let func: ExprTypeBidir = e
+            while (func.tag === "EApply") {
+                visit(func.arg, inLambda)
+                numArgs++
+                func = func.func
+            }
+            if (!(func.tag === "EVar" && func.name === name && !inLambda && numArgs === arity)) {
+                visit(func, inLambda)
+            }
+            return
+        }
+        let inLambda2 = inLambda || isLambdaExpr(e)
+        exprTour(e, { expr: (e2) => visit(e2, inLambda2) })
+    }
+    exprs.forEach(e => visit(e, false))
+    return ok
+}
+
+// Escape-analysis for closure environments.
+// A let-bound lambda, within this function body, whose variable is only ever used in saturated calls,
+//   cannot have its closure outlive the C function generated for this body.
+// The environments for such closures are allocated in the C stack-frame, rather than on the heap.
+// Nested lambdas are not searched, they are analysed when their own function bodies are generated.
+// Nothing in such an environment can be reachable from the function's result, so no copy-on-return is needed.
+function findStackEnvLambdas(cb: CBuilder, body: ExprTypeBidir): void {
+    let visit = (e: ExprTypeBidir): undefined => {
+        if (isLambdaExpr(e)) {
+            return
+        }
+        if (e.tag === "ELet") {
+            let scope = [...e.decls.map(([, defn]) => defn), e.expr]
+            for (let [pat, defn] of e.decls) {
+                let lam = getLambdaOrNull(defn)
+                let name =
+                    pat.tag === "EVar" ? pat.name
+                        : pat.tag === "EType" && pat.expr.tag === "EVar" ? pat.expr.name
+                            : undefined
+                if (lam !== null && name !== undefined && varOnlyCalled(name, lambdaArity(lam), scope)) {
+                    cb.stackEnvLambdas.add(lam)
+                }
+            }
+        }
+        exprTour(e, { expr: visit })
+    }
+    visit(body)
+}
+
 function cgc_lambda3(cb: CBuilder, expr: ExprTypeBidir, nameHint?: string, targetRepr?: CRepr): CExprRepr {
     switch (expr.tag) {
         case "ELambda":
@@ -2261,6 +2408,8 @@ function cgc_lambda3(cb: CBuilder, expr: ExprTypeBidir, nameHint?: string, targe
 
             let paramVRs: CVarRepr[] = []
 
+            findStackEnvLambdas(cb, body)
+
             let returnVar = cb.freshVar(codR, "returnVar")
             let scAssignReturnVar = scAssign(returnVar)
             if (lastLambda.tag === "ELambdaYes" || lastLambda.tag === "ELambdaMaybe") {
@@ -2347,7 +2496,15 @@ function cgc_lambda3(cb: CBuilder, expr: ExprTypeBidir, nameHint?: string, targe
                 closVars.unshift(cAggregate([cOp("&_", [envStructName])]))
 
                 let envVar = cb.freshVar(rAny);
-                cb.addStmts([cExprStmt(cCall(cCode("MALLOC"), [cCode(closEnvStructName), envVar, cAggregate(closVars)]))])
+                if (cb.stackEnvLambdas.has(expr)) {
+                    // the closure cannot escape the current C function, so neither can its environment
+                    let envStackVar = cb.freshVar(rNone, "envStack")
+                    cb.addStmts([cVarDecl(tName(closEnvStructName), envStackVar, cAggregate(closVars))])
+                    cb.addStmts([cVarDecl(closEnvCTy, envVar, cAddrOf(envStackVar))])
+                }
+                else {
+                    cb.addStmts([cExprStmt(cCall(cCode("MALLOC_SCHEMA"), [cCode(closEnvStructName), envVar, cAddrOf(envStructName), cAggregate(closVars)]))])
+                }
                 let closVar = cb.freshVar(funcR);
                 let closRepr = funcR as CReprClos
                 let closValue =
@@ -2876,13 +3033,44 @@ function stmt_forFoldLeft(cb: CBuilder, funcName: string, args: ExprTypeBidir[])
                 ])
 
             let bodySc = scAssign(zVar)
+
+            if (xRepr.tag === "List") {
+                // An unboxed List is walked a segment at a time,
+                //   each segment's elements are contiguous, so the body goes in a tight loop over an array.
+                let elemsVar = cb.freshVar(rNone, "elems")
+                let countVar = cb.freshVar(rInt, "count")
+                let iVar = cb.freshVar(rInt, "i")
+                let elemsTy = tPtr(reprToCType(x1Repr))
+                cb.pushNewCtx()
+                {
+                    cb.addStmts([cAssignStmt(x1Var, cOp("[]", [elemsVar, iVar]))])
+                    cgc_pat_mat(cb, typeDom(loopLam1.ty2!), zVar, zPat, patMatFail_fatalError)
+                    cgc_pat_mat(cb, typeHd(typeDom(loopLam2.ty2!)), x1Var, x1Pat, patMatFail_fatalError)
+                    cgc_stmt_stmt(cb, loopBody, bodySc)
+                }
+                let [patBodyStmtsC,] = cb.popCtx()
+
+                // The list is only stepped on once the body has run over the whole span,
+                //   so the span's segment stays reachable while the body allocates.
+                let span = cCall(cCode("list_spanAt"), [reprToReprExpr(x1Repr), cField(xVar, "elems"), cOp("&_", [countVar])])
+                let spanRest = cCall(cCode("list_spanRest"), [cField(xVar, "elems")])
+                let forC = cFor(reprToCType(rInt), iVar, cInt(0), cOp("!=", [iVar, countVar]), cOp("_++", [iVar]), patBodyStmtsC)
+                cb.addStmts([
+                    cVarDeclUndefined(reprToCType(rInt), countVar),
+                    cWhile(cg_isPair(cb, xVar), [
+                        cVarDecl(elemsTy, elemsVar, span),
+                        forC,
+                        cAssignStmt(cField(xVar, "elems"), spanRest),
+                    ]),
+                ])
+                sc_close(cb, stmtCtx, zVar)
+                return
+            }
+
             cb.pushNewCtx()
             {
-                cb.addStmts(
-                    [cIf(cg_isNil(cb, xVar), [cBreak()]),
-                    cAssignStmt(x1Var, cg_head(cb, xVar)),
-                    cAssignStmt(xVar, cg_tail(cb, xVar))
-                    ])
+                cb.addStmts([cIf(cg_isNil(cb, xVar), [cBreak()])])
+                cb.addStmts([cAssignStmt(x1Var, cg_frontPop(cb, xVar))])
                 cgc_pat_mat(cb, typeDom(loopLam1.ty2!), zVar, zPat, patMatFail_fatalError)
                 cgc_pat_mat(cb, typeHd(typeDom(loopLam2.ty2!)), x1Var, x1Pat, patMatFail_fatalError)
                 cgc_stmt_stmt(cb, loopBody, bodySc)
@@ -3089,11 +3277,11 @@ function cg_eq(cb: CBuilder, lhs: CExprRepr, rhs: CExprRepr): CExprRepr {
         return natExpr(rBool, cCall(cCode("char_eq"), [lhs, rhs]))
     }
     else if (lhs.repr.tag === "Single" && lhs.repr.value.length === 1 && rhs.repr.tag === "Char") {
-        let lhs2 = cCast(tName("Char"), cAggregate([cCode(cQuoteStr("'", lhs.repr.value))]))
+        let lhs2 = cCast(tName("Char"), cAggregate([cCharCode(lhs.repr.value)]))
         return natExpr(rBool, cCall(cCode("char_eq"), [lhs2, rhs]))
     }
     else if (lhs.repr.tag === "Char" && rhs.repr.tag === "Single" && rhs.repr.value.length === 1) {
-        let rhs2 = cCast(tName("Char"), cAggregate([cCode(cQuoteStr("'", rhs.repr.value))]))
+        let rhs2 = cCast(tName("Char"), cAggregate([cCharCode(rhs.repr.value)]))
         return natExpr(rBool, cCall(cCode("char_eq"), [lhs, rhs2]))
     }
     else if (isStringyRepr(lhs.repr) && rhs.repr.tag === "Char") {
@@ -3184,6 +3372,23 @@ function cg_tail(cb: CBuilder, arg: CExprRepr): CExprRepr {
             return anyExpr(cCall(cCode("any_tail"), [toAny(cb, arg)]))
     }
 }
+// Takes the head of a list variable, and steps the variable on to the tail.
+// An unboxed List is stepped in place, with list_frontPop.
+function cg_frontPop(cb: CBuilder, listVar: CVarRepr): CExprRepr {
+    switch (listVar.repr.tag) {
+        case "List": {
+            let elemRepr = listVar.repr.elemRepr
+            let h = cCall(cCode("list_frontPop"), [reprToReprExpr(elemRepr), cOp("&_", [cField(listVar, "elems")])])
+            h = cOp("*_", [cCast(tPtr(reprToCType(elemRepr)), h)])
+            return natExpr(elemRepr, h)
+        }
+        default: {
+            let h = toVar(cb, cg_head(cb, listVar))
+            cb.addStmts([cAssignStmt(listVar, cg_tail(cb, listVar))])
+            return h
+        }
+    }
+}
 
 
 function isStringyType(ty: Type): boolean {
@@ -4328,7 +4533,7 @@ function createTupleRepr(cb: CBuilder, elemReprs: CRepr[], nameHint?: string): C
     ])
 
     let tupleTypeAgg = cAggregateConst([
-        cAggregate([cCode("Repr_Tuple"), cCall(cCode("sizeof"), [cCode(cShowType(structName))])]),
+        cAggregate([cCode("Repr_Tuple"), cCall(cCode("sizeof"), [cCode(cShowType(structName))]), ...reprBaseFlags(elemReprs.every(reprPointerFree))]),
         cOp("&_", [cCast(tName("Schema"), agg)]),
     ])
     cb.addGlobalStmts("AuxC", [cVarDecl(tConst(tName("ReprTuple")), tupleType, tupleTypeAgg)])
@@ -4360,7 +4565,7 @@ function createMaybeRepr(cb: CBuilder, valRepr: CRepr, nameHint?: string): CRepr
         ])])
 
     let maybeReprAgg = cAggregateConst([
-        cAggregate([cCode("Repr_Maybe"), cCall(cCode("sizeof"), [cCode(cShowType(maybeName))])]),
+        cAggregate([cCode("Repr_Maybe"), cCall(cCode("sizeof"), [cCode(cShowType(maybeName))]), ...reprBaseFlags(reprPointerFree(valRepr))]),
         reprToReprExpr(valRepr),
         cCode(`offsetof(${cShowType(maybeName)},value)`)
     ])
@@ -4387,7 +4592,7 @@ function createYesRepr(cb: CBuilder, elemRepr: CRepr): CReprYes {
     let elemReprCExp = reprToReprExpr(elemRepr)
 
     let yesTypeAgg = cAggregateConst([
-        cAggregate([cCode("Repr_Yes"), cCall(cCode("sizeof"), [cCode(cShowType(typedefTy))])]),
+        cAggregate([cCode("Repr_Yes"), cCall(cCode("sizeof"), [cCode(cShowType(typedefTy))]), ...reprBaseFlags(reprPointerFree(elemRepr))]),
         elemReprCExp
     ])
     cb.addGlobalStmts("AuxH", [cTypeDef(typedefTy, reprToCType(elemRepr))])
@@ -4417,7 +4622,8 @@ function createListRepr(cb: CBuilder, elemRepr: CRepr, nameHint?: string): CRepr
     cb.addGlobalStmts("AuxH", [cStructDecl(cShowType(listCType), fields)])
 
     let listTypeAgg = cAggregateConst([
-        cAggregate([cCode("Repr_List"), cCall(cCode("sizeof"), [cCode("List")])]),
+        // a List always points to its segments, the elemRepr says whether the segment elements are pointer-free
+        cAggregate([cCode("Repr_List"), cCall(cCode("sizeof"), [cCode("List")]), ...reprBaseFlags(false)]),
         elemReprExpr
     ])
     cb.addGlobalStmts("AuxC", [cVarDecl(tConst(tName("ReprList")), listReprExpr, listTypeAgg)])
@@ -4475,7 +4681,7 @@ function createUnionRepr(cb: CBuilder, altReprs: CRepr[], nameHint?: string, use
     cb.addGlobalStmts("AuxH", [cStructDecl(cShowType(unionCType), fields)])
 
     let unionReprAgg = cAggregateConst([
-        cAggregateConst([cCode("Repr_Union"), cCall(cCode("sizeof"), [cCode(cShowType(unionCType))])]),
+        cAggregateConst([cCode("Repr_Union"), cCall(cCode("sizeof"), [cCode(cShowType(unionCType))]), ...reprBaseFlags(altReprs.every(reprPointerFree))]),
         cInt(altReprs.length),
         cCast(tArray(tName("Repr"), altReprs.length), cAggregateVert(altReprs.map(r => reprToReprExpr(r)))),
         cCode(`offsetof(${cShowType(unionCType)},value)`)
@@ -4611,13 +4817,16 @@ function createSingleRepr(cb: CBuilder, value: string): CReprSingle {
     let fields: [string, CType][] = []
     cb.addGlobalStmts("AuxH", [cStructDecl(cShowType(singleCType), fields)])
 
-    let strC = cb.staticString(value)
-
+    // The static string is written out in full, a variable can't be used in a static initializer.
+    // The repr isn't const, str_internStatic replaces the string with the canonical instance, should one already be interned.
     let singleReprAgg = cAggregateConst([
-        cAggregateConst([cCode("Repr_Single"), cCall(cCode("sizeof"), [cCode(cShowType(singleCType))])]),
-        strC,
+        cAggregateConst([cCode("Repr_Single"), cCall(cCode("sizeof"), [cCode(cShowType(singleCType))]), ...reprBaseFlags(true)]),
+        cAggregateConst(staticStrFields(value)),
+    ])
+    cb.addGlobalStmts("AuxC", [
+        cVarDecl(tName("ReprSingle"), singleReprExpr, singleReprAgg),
+        cExprStmt(cCall(cCode("str_internStatic"), [cAddrOf(cField(singleReprExpr, "value"))])),
     ])
-    cb.addGlobalStmts("AuxC", [cVarDecl(tConst(tName("ReprSingle")), singleReprExpr, singleReprAgg)])
 
     let listTy2: CReprSingle = rSingle(singleCType, singleReprExpr.expr, value)
     cb.memoMaps.singleReprMemo.set(memoKey, listTy2)
@@ -5252,6 +5461,12 @@ function cgc_decls(cb: CBuilder, decls: DeclTypeBidir[], env?: Env): void {
 }
 
 
+// A character literal, or the code point of a non-ASCII character.
+function cCharCode(ch: string): CExpr {
+    let cp = ch.codePointAt(0)!
+    return cp <= 127 ? cCode(cQuoteStr("'", ch)) : cInt(cp)
+}
+
 function cQuoteStr(q: "'" | '"', s: string) {
     let chars: string[] = []
     let len = s.length
@@ -5287,10 +5502,14 @@ function cQuoteStr(q: "'" | '"', s: string) {
             let lo = hexChars.charAt(cNum & 0x0F)
             c2 = `\\x${hi}${lo}`
         }
+        else if (q === '"') {
+            // non-ASCII characters are UTF-8 encoded, as octal escapes,
+            //   (unlike a hex escape, an octal escape can't run on into the characters which follow it)
+            let ch = String.fromCodePoint(s.codePointAt(i)!)
+            i += ch.length - 1
+            c2 = Array.from(new TextEncoder().encode(ch), b => `\\${b.toString(8)}`).join("")
+        }
         else {
-            // TODO use unicode syntax for chars > 127 (or 255?)
-            // throw new Error("TODO unicode in a C string")
-            // not actually expecting to encounter non-ASCII characters here though
             throw new Error(`unexpected non-ASCII character (${JSON.stringify(c)}, ${cNum})`)
         }
         chars.push(c2)
@@ -5352,6 +5571,8 @@ function cShowExpr(expr: CExpr): string {
                     return `(&${a[0]})`
                 case "*_":
                     return `*${a[0]}`
+                case "_++":
+                    return `${a[0]}++`
                 default:
                     throw new Error(`unknown/unhandled operator ${expr.opName}`)
             }
@@ -5421,6 +5642,11 @@ function cShowStmt(out: string[], indent: string, stmt: CStmt) {
             cShowStmts(out, indent2, stmt.body)
             out.push(`${indent}}`)
             return
+        case "CFor":
+            out.push(`${indent}for (${cShowType(stmt.ty, stmt.var.name)} = ${cShowExpr(stmt.init)}; ${cShowExpr(stmt.cond)}; ${cShowExpr(stmt.step)}) {`)
+            cShowStmts(out, indent2, stmt.body)
+            out.push(`${indent}}`)
+            return
         case "CBreak":
             out.push(`${indent}break;`)
             return
@@ -29,6 +29,8 @@ import { SubstEnv, Substitute } from "./graph-substitute.js";
 import { GraphPredicates } from "../graph/graph-predicates.js";
 import { GraphApply } from "./graph-apply.js";
 import { isAlpha, scan2Fe } from "../syntax/scan.js";
+import { strSpanWhile, strFindAny, strIndexOf } from "../utils/str-scan.js";
+import { intListSum, intListMin, intListMax, intListIndexOf, intListEq, intListCompare, charListIndexOf, charListEq, charListCompare } from "../utils/list-scan.js";
 import { ParseState } from "../syntax/parse.js";
 import { parseTerm, parseType } from "../syntax/parseFerrum2.js";
 import { mkGraphBuilder } from "./graph-builder.js";
@@ -2816,6 +2818,69 @@ export function mkPrims(): Primitives {
             }
         }
 
+        function mkDatum3Action(aJsTypeOf: string, bJsTypeOf: string, cJsTypeOf: string, op: (a: Datum, b: Datum, c: Datum) => Datum): Action {
+            return (depth, [a0, b0, c0]) => {
+                const a = dOf(a0)
+                const b = dOf(b0)
+                const c = dOf(c0)
+                if (h.isTmDatum(a) && h.isTmDatum(b) && h.isTmDatum(c)) {
+                    const aVal = h.datum_tm(a)
+                    const bVal = h.datum_tm(b)
+                    const cVal = h.datum_tm(c)
+                    if (typeof (aVal) === aJsTypeOf && typeof (bVal) === bJsTypeOf && typeof (cVal) === cJsTypeOf) {
+                        const result = op(aVal, bVal, cVal)
+                        return h.tmDatum(result)
+                    }
+                }
+                return null
+            }
+        }
+
+        // The datums of a fully evaluated list, or null if it isn't one (yet).
+        function datumList(a0: Addr, jsTypeOf: string): Datum[] | null {
+            const elems: Datum[] = []
+            let a = dOf(a0)
+            while (h.isTmPair(a)) {
+                const hd = dOf(h.hd_tm(a))
+                let hdVal: Datum
+                if (h.isTmDatum(hd) && (hdVal = h.datum_tm(hd), typeof hdVal === jsTypeOf)) {
+                    elems.push(hdVal)
+                }
+                else {
+                    return null
+                }
+                a = dOf(h.tl_tm(a))
+            }
+            if (h.isTmDatum(a) && h.datum_tm(a) === null) {
+                return elems
+            }
+            return null
+        }
+
+        // The arguments marked "list" are lists of datums of the given JS type, the others are datums.
+        function mkDatumListAction(argKinds: ("list" | "datum")[], jsTypeOf: string, op: (...args: any[]) => Datum): Action {
+            return (depth, args) => {
+                const vals: any[] = []
+                for (let i = 0; i !== args.length; i++) {
+                    if (argKinds[i] === "list") {
+                        const elems = datumList(args[i], jsTypeOf)
+                        if (elems === null) {
+                            return null
+                        }
+                        vals.push(elems)
+                    }
+                    else {
+                        const a = dOf(args[i])
+                        if (!h.isTmDatum(a)) {
+                            return null
+                        }
+                        vals.push(h.datum_tm(a))
+                    }
+                }
+                return h.tmDatum(op(...vals))
+            }
+        }
+
         // { { a : Int } -> { b : Int } -> (Single (a + b)) <: Int }
         // { { a : Int } -> { b : Int } -> _ <: Int }
         // { A @ Int -> B @ Int -> A + B <: Int }
@@ -3274,6 +3339,56 @@ export function mkPrims(): Primitives {
             mkDatum2Action("string", "number", (a: any, b: any) => (a as string).charAt(b))
         )
 
+        builtinId("strSlice",     /**/[weak, weak, weak], parseTy('{ Str -> Int -> Int -> Str }'), (depth, [a0, b0, c0]) => {
+            const a = h.directAddrOf(a0)
+            const b = h.directAddrOf(b0)
+            const c = h.directAddrOf(c0)
+            if (h.isTmDatum(a) && h.isTmDatum(b) && h.isTmDatum(c)) {
+                const strVal = h.datum_tm(a)
+                const startVal = h.datum_tm(b)
+                const endVal = h.datum_tm(c)
+                if (typeof strVal === "string" && typeof startVal === "number" && typeof endVal === "number") {
+                    return h.tmDatum(strVal.slice(Math.max(0, startVal), Math.max(0, endVal)), depthZero, tyStr)
+                }
+            }
+            return null
+        })
+        builtinId("strSplit",     /**/[weak, weak], parseTy('{ Str -> Str -> (List Str) }'), (depth, [a0, b0]) => {
+            const a = h.directAddrOf(a0)
+            const b = h.directAddrOf(b0)
+            if (h.isTmDatum(a) && h.isTmDatum(b)) {
+                const delimVal = h.datum_tm(a)
+                const strVal = h.datum_tm(b)
+                if (typeof delimVal === "string" && typeof strVal === "string") {
+                    let result: Addr = nilTerm
+                    for (const part of strVal.split(delimVal).reverse()) {
+                        result = h.tmPair(h.tmDatum(part, depthZero, tyStr), result, depth)
+                    }
+                    return result
+                }
+            }
+            return null
+        })
+        builtinId("strSpanWhile", /**/[weak, weak, weak], parseTy('{ Str -> Int -> Str -> Int }'),
+            mkDatum3Action("string", "number", "string", (a: any, b: any, c: any) => strSpanWhile(a, b, c))
+        )
+        builtinId("strFindAny",   /**/[weak, weak, weak], parseTy('{ Str -> Int -> Str -> Int }'),
+            mkDatum3Action("string", "number", "string", (a: any, b: any, c: any) => strFindAny(a, b, c))
+        )
+        builtinId("strIndexOf",   /**/[weak, weak, weak], parseTy('{ Str -> Int -> Str -> Int }'),
+            mkDatum3Action("string", "number", "string", (a: any, b: any, c: any) => strIndexOf(a, b, c))
+        )
+
+        builtinId("intListSum",      /**/[weak], parseTy('{ (List Int) -> Int }'), mkDatumListAction(["list"], "number", intListSum))
+        builtinId("intListMin",      /**/[weak, weak], parseTy('{ Int -> (List Int) -> Int }'), mkDatumListAction(["datum", "list"], "number", intListMin))
+        builtinId("intListMax",      /**/[weak, weak], parseTy('{ Int -> (List Int) -> Int }'), mkDatumListAction(["datum", "list"], "number", intListMax))
+        builtinId("intListIndexOf",  /**/[weak, weak], parseTy('{ (List Int) -> Int -> Int }'), mkDatumListAction(["list", "datum"], "number", intListIndexOf))
+        builtinId("intListEq",       /**/[weak, weak], parseTy('{ (List Int) -> (List Int) -> Bool }'), mkDatumListAction(["list", "list"], "number", intListEq))
+        builtinId("intListCompare",  /**/[weak, weak], parseTy('{ (List Int) -> (List Int) -> Int }'), mkDatumListAction(["list", "list"], "number", intListCompare))
+        builtinId("charListIndexOf", /**/[weak, weak], parseTy('{ (List Char) -> Char -> Int }'), mkDatumListAction(["list", "datum"], "string", charListIndexOf))
+        builtinId("charListEq",      /**/[weak, weak], parseTy('{ (List Char) -> (List Char) -> Bool }'), mkDatumListAction(["list", "list"], "string", charListEq))
+        builtinId("charListCompare", /**/[weak, weak], parseTy('{ (List Char) -> (List Char) -> Int }'), mkDatumListAction(["list", "list"], "string", charListCompare))
+
         builtinId("strCharAtMb",  /**/[weak, weak], parseTy('{ Str -> Int -> [] | [Char] }'), (depth, [a0, b0]) => {
             const a = h.directAddrOf(a0)
             const b = h.directAddrOf(b0)
@@ -3468,6 +3583,7 @@ export function mkPrims(): Primitives {
             ["testIsNil", "ifNil"],
             ["Single", "a -> Type"],
             ["castT", "(a : Any) -> (a : Void)"],
+            ["hashCons", "a -> a"],
             ["Domain", "Dom"],
             ["Codomain", "Cod"],
             ["SelfT", "(f : { Type -> Type }) -> Self <| (a : A @ Any) -> f A"],
@@ -3493,6 +3609,7 @@ export function mkPrims(): Primitives {
             // // primTODO("jsEvalMaybe"),
             // primTODO("primMkArrayFastAccessNoCopy"),
             // primTODO("primMkArrayFastAccessSlowCopy"),
+            // primTODO("primMkStringBuilder"),
             // primTODO("primAssoc1MkEphemeral"),
             // primTODO("primAssoc1MkPersistent"),
             // primTODO("primHpsCall"),
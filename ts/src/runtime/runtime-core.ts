@@ -1,5 +1,7 @@
 
 import { assert } from "../utils/assert.js"
+import { strSpanWhile, strFindAny, strIndexOf } from "../utils/str-scan.js"
+import { intListSum, intListMin, intListMax, intListIndexOf, intListEq, intListCompare, charListIndexOf, charListEq, charListCompare } from "../utils/list-scan.js"
 
 let console_log = console.log
 // let console_log = console.error
@@ -393,6 +395,61 @@ let primMkArrayFastAccessNoCopy2 =
     }
 
 
+// An ephemeral string-builder object, the JS counterpart of the C runtime's StringBuilder.
+// As with primMkArrayFastAccessNoCopy, only the most recent instance of the object can be used.
+type FeStringBuilder = (req: any) => [FeStringBuilder, [FeValue, FeNil]]
+// The builder's length is counted in the same units as strLen, UTF-16 code units in this runtime.
+// (The C runtime counts code points, so the two backends agree only for text within the BMP.)
+type StringBuilderState = { parts: string[], len: number, seqId: number }
+
+let primMkStringBuilder = (unused: FeValue): FeStringBuilder => {
+    return primMkStringBuilder2({ parts: [], len: 0, seqId: 0 })
+}
+
+let primMkStringBuilder2 =
+    (state: StringBuilderState): FeStringBuilder => {
+        let seqId2 = state.seqId
+        return (req: any) => {
+            if (seqId2 !== state.seqId) {
+                throw new Error(`Runtime Error: stale string-builder reference (${seqId2}) expected (${state.seqId})`)
+            }
+            state.seqId += 1
+            let result: FeValue
+            switch (req[0]) {
+                case "append": {
+                    let str: string = req[1][0]
+                    state.parts.push(str)
+                    state.len += str.length
+                    result = null
+                    break
+                }
+                case "appendMany": {
+                    let strs = req[1][0]
+                    while (strs instanceof Array) {
+                        state.parts.push(strs[0])
+                        state.len += strs[0].length
+                        strs = strs[1]
+                    }
+                    result = null
+                    break
+                }
+                case "length": {
+                    result = state.len
+                    break
+                }
+                case "finish": {
+                    result = state.parts.join("")
+                    state.parts = []
+                    state.len = 0
+                    break
+                }
+                default:
+                    throw new Error(`unknown StringBuilder request (${req[0]})`)
+            }
+            return [primMkStringBuilder2(state), [result, null]]
+        }
+    }
+
 
 function isDatum(a: any) {
     switch (typeof a) {
@@ -708,17 +765,21 @@ let primAssoc1MkEphemeral_data = (elems: FeList<FeTuple<[FeData, FeValue]>>) =>
 
 
 
-export function showValueFerrum(node: FeValue, forceToData = false): string {
+// Values nested deeper than maxDepth are shown as "[...]", (zero for no limit).
+export function showValueFerrum(node: FeValue, forceToData = false, maxDepth = 0, depth = 0): string {
     var v = node
     if (v instanceof Array) {
-        let result: string = "[" + showValueFerrum(v[0], forceToData)
+        if (maxDepth !== 0 && depth >= maxDepth) {
+            return "[...]"
+        }
+        let result: string = "[" + showValueFerrum(v[0], forceToData, maxDepth, depth + 1)
         v = v[1]
         while (v instanceof Array) {
-            result += "," + showValueFerrum(v[0])
+            result += "," + showValueFerrum(v[0], false, maxDepth, depth + 1)
             v = v[1]
         }
         if (v !== null) {
-            result += ",," + showValueFerrum(v, forceToData)
+            result += ",," + showValueFerrum(v, forceToData, maxDepth, depth + 1)
         }
         result += "]"
         return result
@@ -1147,6 +1208,11 @@ let primitives2 = () => {
         var value = showValueFerrum(a)
         return value
     }
+    // as the C runtime's any_showLimited, output longer than maxLen is cut short, and ends in "..."
+    prims3.showLimited = (maxLen) => (maxDepth) => (a) => {
+        var value = showValueFerrum(a, false, Math.max(0, maxDepth))
+        return maxLen > 0 && value.length > maxLen ? value.slice(0, maxLen) + "..." : value
+    }
 
 
     prims0.false = false
@@ -1261,6 +1327,8 @@ let primitives2 = () => {
     prims1.coerceT = (val) => (val)
     prims2.castDT = (val) => (typ) => (val)
     prims1.castT = (val) => (val)
+    // Hash-consing only affects the performance of the C runtime, JS strings are already compared by value.
+    prims1.hashCons = (val) => (val)
     prims1.typeOf = (a) => MkType(`(typeOf _)`)
     prims0.fix = fix
     prims0.fix2 = fix
@@ -1295,10 +1363,32 @@ let primitives2 = () => {
         return a.charCodeAt(0) 
     }
     prims1.strChr = (a) => String.fromCharCode(a)
+    // UTF-16 code units, as strCharAt and strSlice index; the C runtime counts code points.
     prims1.strLen = (a) => a.length
     prims2.strAdd = (a) => (b) => a + b
     prims2.strCharAt = (a) => (b) => a.charAt(b)
     prims2.strCharAtMb = (a) => (b) => { let ch = a.charAt(b); return ch === "" ? null : [ch, null]; }
+    prims3.strSlice = (a) => (b) => (c) => a.slice(Math.max(0, b), Math.max(0, c))
+    prims2.strSplit = (delim) => (a) => {
+        let result: FeList<string> = null
+        for (const part of a.split(delim).reverse()) {
+            result = [part, result]
+        }
+        return result
+    }
+    prims3.strSpanWhile = (a) => (b) => (c) => strSpanWhile(a, b, c)
+    prims3.strFindAny = (a) => (b) => (c) => strFindAny(a, b, c)
+    prims3.strIndexOf = (a) => (b) => (c) => strIndexOf(a, b, c)
+
+    prims1.intListSum = (a) => intListSum(feList_toList(a))
+    prims2.intListMin = (z) => (a) => intListMin(z, feList_toList(a))
+    prims2.intListMax = (z) => (a) => intListMax(z, feList_toList(a))
+    prims2.intListIndexOf = (a) => (x) => intListIndexOf(feList_toList(a), x)
+    prims2.intListEq = (a) => (b) => intListEq(feList_toList(a), feList_toList(b))
+    prims2.intListCompare = (a) => (b) => intListCompare(feList_toList(a), feList_toList(b))
+    prims2.charListIndexOf = (a) => (x) => charListIndexOf(feList_toList(a), x)
+    prims2.charListEq = (a) => (b) => charListEq(feList_toList(a), feList_toList(b))
+    prims2.charListCompare = (a) => (b) => charListCompare(feList_toList(a), feList_toList(b))
 
     prims2.jsStrJoin = (delim) => (parts) => {
         if (typeof (delim) !== "string") {
@@ -1323,6 +1413,7 @@ let primitives2 = () => {
 
     prims0.primMkArrayFastAccessSlowCopy = primMkArrayFastAccessSlowCopy
     prims0.primMkArrayFastAccessNoCopy = primMkArrayFastAccessNoCopy
+    prims0.primMkStringBuilder = primMkStringBuilder
 
     prims0.primAssoc1MkPersistent = primAssoc1MkPersistent_data;
     prims0.primAssoc1MkEphemeral = primAssoc1MkEphemeral_data;
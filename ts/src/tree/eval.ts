@@ -267,20 +267,24 @@ export function printValue(node: Node, bracketsNeeded: boolean): string {
 }
 
 
-export function showValueFe(node: Node): string {
+// Values nested deeper than maxDepth are shown as "[...]", (zero for no limit).
+export function showValueFe(node: Node, maxDepth = 0, depth = 0): string {
     let n = node
     let v = evalNode(n)
     if (v.tag === "pair") {
-        let result = "[" + showValueFe(v.head)
+        if (maxDepth !== 0 && depth >= maxDepth) {
+            return "[...]"
+        }
+        let result = "[" + showValueFe(v.head, maxDepth, depth + 1)
         n = v.tail
         v = evalNode(n)
         while (v.tag === "pair") {
-            result += "," + showValueFe(v.head)
+            result += "," + showValueFe(v.head, maxDepth, depth + 1)
             n = v.tail
             v = evalNode(n)
         }
         if (v.tag !== "atomic" || v.value !== null) {
-            result += ",," + showValueFe(n)
+            result += ",," + showValueFe(n, maxDepth, depth + 1)
         }
         result += "]"
         return result
@@ -9,6 +9,8 @@ import {
 } from "../tree/eval.js"
 import { logger_log } from "../utils/logger.js"
 import { assert } from "../utils/assert.js"
+import { strSpanWhile, strFindAny, strIndexOf } from "../utils/str-scan.js"
+import { intListSum, intListMin, intListMax, intListIndexOf, intListEq, intListCompare, charListIndexOf, charListEq, charListCompare } from "../utils/list-scan.js"
 
 import {
     nilT, boolT, intT, strT, anyT, pairT, listT, funT, funPT, funDT, varT, voidT, ruleT, typeT, singleT, unionTypes, ioWorldT, errorT,
@@ -179,6 +181,19 @@ function showPrimFe(args: Node[]): Node {
     return node(atomicValue(txt))
 }
 
+// As the C runtime's any_showLimited, output longer than maxLen is cut short, and ends in "...".
+function showLimitedPrim(args: Node[]): Node {
+    let [maxLen, maxDepth, a] = args.map(evalNode)
+    if (maxLen.tag !== "atomic" || maxDepth.tag !== "atomic") {
+        throw new Error(`expected two limits, not (${JSON.stringify([maxLen, maxDepth])})`)
+    }
+    let txt = showValueFe(args[2], Math.max(0, maxDepth.value))
+    if (maxLen.value > 0 && txt.length > maxLen.value) {
+        txt = txt.slice(0, maxLen.value) + "..."
+    }
+    return node(atomicValue(txt))
+}
+
 function showTypePrim(args: Node[]): Node {
     let [a] = args
     let txt = JSON.stringify(a)
@@ -596,6 +611,62 @@ let strJoinPrim = (args: Node[]): Node => {
     return node(atomicValue(resultStr))
 }
 
+function strSlicePrim(args: Node[]): Node {
+    let [a, b, c] = args.map(evalNode)
+    if (a.tag !== "atomic" || typeof (a.value) !== "string" || b.tag !== "atomic" || c.tag !== "atomic") {
+        throw new Error(`expected a string and two positions, not (${JSON.stringify([a, b, c])})`)
+    }
+    return node(atomicValue(a.value.slice(Math.max(0, b.value), Math.max(0, c.value))))
+}
+
+function strSplitPrim(args: Node[]): Node {
+    let [a, b] = args.map(evalNode)
+    if (a.tag !== "atomic" || typeof (a.value) !== "string" || b.tag !== "atomic" || typeof (b.value) !== "string") {
+        throw new Error(`expected a delimiter and a string, not (${JSON.stringify([a, b])})`)
+    }
+    let result = node(atomicValue(null))
+    b.value.split(a.value).reverse().forEach(part => {
+        result = node(pairValue(node(atomicValue(part)), result))
+    })
+    return result
+}
+
+function mkStrScanPrim(scan: (a: string, pos: number, chars: string) => number) {
+    return (args: Node[]): Node => {
+        let [a, b, c] = args.map(evalNode)
+        if (a.tag !== "atomic" || typeof (a.value) !== "string" || b.tag !== "atomic" || c.tag !== "atomic" || typeof (c.value) !== "string") {
+            throw new Error(`expected a string, a position and a string, not (${JSON.stringify([a, b, c])})`)
+        }
+        return node(atomicValue(scan(a.value, b.value, c.value)))
+    }
+}
+
+function collectListAtoms(a: Node, jsTypeOf: string): any[] {
+    return collectListElems(a).map(el => {
+        if (el.tag !== "atomic" || typeof (el.value) !== jsTypeOf) {
+            throw new Error(`expected a ${jsTypeOf} in list, not (${JSON.stringify(el)})`)
+        }
+        return el.value
+    })
+}
+
+// The arguments marked "list" are lists of atoms of the given JS type, the others are atoms.
+function mkListScanPrim(argKinds: ("list" | "atom")[], jsTypeOf: string, scan: (...args: any[]) => any) {
+    return (args: Node[]): Node => {
+        let vals = args.map((arg, i) => {
+            if (argKinds[i] === "list") {
+                return collectListAtoms(arg, jsTypeOf)
+            }
+            let a = evalNode(arg)
+            if (a.tag !== "atomic") {
+                throw new Error(`expected an atomic value, not (${JSON.stringify(a)})`)
+            }
+            return a.value
+        })
+        return node(atomicValue(scan(...vals)))
+    }
+}
+
 function strCharAtMbPrim(args: Node[]): Node {
     const [a, b] = args
     const a2 = evalNode(a)
@@ -703,6 +774,7 @@ const primTable: PrimTable = {
     "error": [1, errorPrim2, funT(anyT, errorT)],
     "show": [1, showPrim2, funT(anyT, strT)],
     "show2": [1, showPrimFe, funT(anyT, strT)],
+    "showLimited": [3, showLimitedPrim, funT(intT, funT(intT, funT(anyT, strT)))],
     "showType": [1, showTypePrim, funT(typeT, strT)],
     "false": [0, mkConstPrim(false), boolT],
     "true": [0, mkConstPrim(true), boolT],
@@ -757,6 +829,8 @@ const primTable: PrimTable = {
     "coerceT": [1, mkTypeFuncPrim(a => a), funT(anyT, voidT)],
     // "castT": [1, mkTypeFuncPrim(a => a), funT(anyT, voidT)], 
     "castT": [1, (([a]: Node[]) => a), funT(anyT, voidT)],
+    // Hash-consing only affects the performance of the C runtime, here it is the identity function.
+    "hashCons": [1, (([a]: Node[]) => a), funPT("T", anyT, varT("T"))],
 
     // TODO make cast be explicit about types
     // "cast": [castTypePrim2, funHT("A", typeT, funHT("B", typeT, funT(varT("A"), varT("B")))), 'prim'],
@@ -796,6 +870,7 @@ const primTable: PrimTable = {
 
     "primMkArrayFastAccessSlowCopy": [1, todoPrim2("primMkArrayFastAccessSlowCopy"), funT(voidT, anyT)],
     "primMkArrayFastAccessNoCopy": [1, todoPrim2("primMkArrayFastAccessNoCopy"), funT(voidT, anyT)],
+    "primMkStringBuilder": [1, todoPrim2("primMkStringBuilder"), funT(voidT, anyT)],
 
     "primAssoc1MkPersistent": [1, todoPrim2("primAssoc1MkPersistent"), funT(voidT, anyT)],
     "primAssoc1MkEphemeral": [1, todoPrim2("primAssoc1MkEphemeral"), funT(voidT, anyT)],
@@ -838,11 +913,26 @@ const primTable: PrimTable = {
     "strAdd": [2, mkBinaryFunction2((a, b) => a + b), funT(strT, funT(strT, strT))],
     "strCharAt": [2, mkBinaryFunction2((a, b) => a.charAt(b)), funT(strT, funT(intT, strT))],
     "strCharAtMb": [2, strCharAtMbPrim, funT(strT, funT(intT, maybeT(charT)))],
+    "strSlice": [3, strSlicePrim, funT(strT, funT(intT, funT(intT, strT)))],
+    "strSplit": [2, strSplitPrim, funT(strT, funT(strT, listT(strT)))],
+    "strSpanWhile": [3, mkStrScanPrim(strSpanWhile), funT(strT, funT(intT, funT(strT, intT)))],
+    "strFindAny": [3, mkStrScanPrim(strFindAny), funT(strT, funT(intT, funT(strT, intT)))],
+    "strIndexOf": [3, mkStrScanPrim(strIndexOf), funT(strT, funT(intT, funT(strT, intT)))],
 
     "jsStrCat": [1, strCatPrim, funT(listT(strT), strT)],
     "jsStrJoin": [2, strJoinPrim, funT(strT, funT(listT(strT), strT))],
     "char_concat": [1, strCatPrim, funT(listT(charT), strT)],
 
+    "intListSum": [1, mkListScanPrim(["list"], "number", intListSum), funT(listT(intT), intT)],
+    "intListMin": [2, mkListScanPrim(["atom", "list"], "number", intListMin), funT(intT, funT(listT(intT), intT))],
+    "intListMax": [2, mkListScanPrim(["atom", "list"], "number", intListMax), funT(intT, funT(listT(intT), intT))],
+    "intListIndexOf": [2, mkListScanPrim(["list", "atom"], "number", intListIndexOf), funT(listT(intT), funT(intT, intT))],
+    "intListEq": [2, mkListScanPrim(["list", "list"], "number", intListEq), funT(listT(intT), funT(listT(intT), boolT))],
+    "intListCompare": [2, mkListScanPrim(["list", "list"], "number", intListCompare), funT(listT(intT), funT(listT(intT), intT))],
+    "charListIndexOf": [2, mkListScanPrim(["list", "atom"], "string", charListIndexOf), funT(listT(charT), funT(charT, intT))],
+    "charListEq": [2, mkListScanPrim(["list", "list"], "string", charListEq), funT(listT(charT), funT(listT(charT), boolT))],
+    "charListCompare": [2, mkListScanPrim(["list", "list"], "string", charListCompare), funT(listT(charT), funT(listT(charT), intT))],
+
     "primHpsDoK": [2, hpsDoK, funT(voidT, anyT)],
     "primHpsDo": [2, prim_hpsDo, funT(voidT, anyT)],
     "primHpsK": [2, prim_hpsCallK, funT(voidT, anyT)],
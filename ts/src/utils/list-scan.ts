@@ -0,0 +1,64 @@
+// List scanning, the JS implementations of the intList* and charList* primitives.
+// The lists are given as JS arrays, Chars as single-character strings.
+// Chars compare by code point, as the C runtime does.
+
+export function intListSum(a: number[]): number {
+    let sum = 0
+    for (const x of a) {
+        sum += x
+    }
+    return sum
+}
+
+// The least (or greatest) of z and the elements.
+export function intListMin(z: number, a: number[]): number {
+    for (const x of a) {
+        z = x < z ? x : z
+    }
+    return z
+}
+
+export function intListMax(z: number, a: number[]): number {
+    for (const x of a) {
+        z = x > z ? x : z
+    }
+    return z
+}
+
+// The position of the first element equal to x, or -1 if there is none.
+export function intListIndexOf(a: number[], x: number): number {
+    return a.indexOf(x)
+}
+
+export function intListEq(a: number[], b: number[]): boolean {
+    return intListCompare(a, b) === 0
+}
+
+// Lexicographic order, -1, 0 or 1.
+export function intListCompare(a: number[], b: number[]): number {
+    return listCompare(a, b, x => x)
+}
+
+export function charListIndexOf(a: string[], x: string): number {
+    return a.indexOf(x)
+}
+
+export function charListEq(a: string[], b: string[]): boolean {
+    return charListCompare(a, b) === 0
+}
+
+export function charListCompare(a: string[], b: string[]): number {
+    return listCompare(a, b, ch => ch.codePointAt(0)!)
+}
+
+function listCompare<T>(a: T[], b: T[], key: (_: T) => number): number {
+    const n = Math.min(a.length, b.length)
+    for (let i = 0; i !== n; i++) {
+        const ka = key(a[i])
+        const kb = key(b[i])
+        if (ka !== kb) {
+            return ka < kb ? -1 : 1
+        }
+    }
+    return Math.sign(a.length - b.length)
+}
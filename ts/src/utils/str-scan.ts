@@ -0,0 +1,26 @@
+// String scanning, the JS implementations of the strSpanWhile, strFindAny and strIndexOf primitives.
+// Positions are clamped to the string, as the C runtime does.
+
+// The end of the run of characters in chars, starting at pos.
+export function strSpanWhile(a: string, pos: number, chars: string): number {
+    let i = Math.min(Math.max(0, pos), a.length)
+    while (i < a.length && chars.includes(a.charAt(i))) {
+        i++
+    }
+    return i
+}
+
+// The position of the first character in chars, at or after pos, or -1 if there is none.
+export function strFindAny(a: string, pos: number, chars: string): number {
+    for (let i = Math.max(0, pos); i < a.length; i++) {
+        if (chars.includes(a.charAt(i))) {
+            return i
+        }
+    }
+    return -1
+}
+
+// The position of the first occurrence of needle, at or after pos, or -1 if there is none.
+export function strIndexOf(a: string, pos: number, needle: string): number {
+    return a.indexOf(needle, Math.max(0, pos))
+}